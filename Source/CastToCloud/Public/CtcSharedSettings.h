@@ -19,6 +19,83 @@ enum class ECtcAnalyticsSpatialTracking : uint8
 	// TODO: Would it make sense to have MouseLocation (slate cursor coords) and maybe ProjectMouseLocation (cursor in 3d space) ?
 };
 
+UENUM()
+enum class ECtcAnalyticsWireFormat : uint8
+{
+	/**
+	 * Every event carries the full session information, user properties and constant attributes
+	 */
+	PerEvent,
+	/**
+	 * Constant information is sent once per batch and events only carry their own attributes. Requires backend support
+	 */
+	SharedContext,
+};
+
+UENUM()
+enum class ECtcAnalyticsCompression : uint8
+{
+	None,
+	Gzip,
+	/**
+	 * Requires a compression format named Zstd to be registered, otherwise falls back to Gzip
+	 */
+	Zstd,
+};
+
+UENUM()
+enum class ECtcAnalyticsOverflowPolicy : uint8
+{
+	/**
+	 * Evicts the oldest cached events to make room for the new ones
+	 */
+	DropOldest,
+	/**
+	 * Rejects new events until the next flush
+	 */
+	DropNewest,
+	/**
+	 * Past half the budget only keeps one out of every DownsampleRate events of each name, past the budget rejects new events
+	 */
+	Downsample,
+	/**
+	 * Writes the events which don't fit to a file on disk, read back by the next flush
+	 */
+	SpillToDisk,
+};
+
+/**
+ * Sampling and rate limit applied to the events of a given name
+ */
+USTRUCT()
+struct CASTTOCLOUD_API FCtcAnalyticsEventSampling
+{
+	GENERATED_BODY()
+
+	/*
+	 * Fraction of the sessions recording the event. Decided once per session, a session either records all of them or none
+	 */
+	UPROPERTY(EditAnywhere, Category = "Sampling", meta = (ClampMin = 0, ClampMax = 1))
+	float SampleRate = 1.0f;
+
+	/*
+	 * Sustained number of events per second allowed through, 0 for no limit
+	 */
+	UPROPERTY(EditAnywhere, Category = "Sampling", meta = (ClampMin = 0))
+	float MaxEventsPerSecond = 0.0f;
+
+	/*
+	 * Number of events allowed through at once before MaxEventsPerSecond applies
+	 */
+	UPROPERTY(EditAnywhere, Category = "Sampling", meta = (ClampMin = 1, EditCondition = "MaxEventsPerSecond > 0"))
+	int32 MaxBurst = 10;
+
+	bool operator==(const FCtcAnalyticsEventSampling& Other) const
+	{
+		return SampleRate == Other.SampleRate && MaxEventsPerSecond == Other.MaxEventsPerSecond && MaxBurst == Other.MaxBurst;
+	}
+};
+
 /**
  * Shared configuration settings shared between all CastToCloud modules
  */
@@ -61,6 +138,155 @@ public:
 	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", meta = (Units = "s"))
 	float SendInterval = 60.0f;
 
+	/*
+	 * Longest interval between flushes. The interval grows up to this value while there are barely any events to send
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (Units = "s"))
+	float MaxIdleSendInterval = 300.0f;
+
+	/*
+	 * Number of cached events which triggers a flush without waiting for the send interval
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 1))
+	int32 FlushEventThreshold = 2000;
+
+	/*
+	 * Memory taken by the cached events which triggers a flush without waiting for the send interval
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "Bytes"))
+	int64 FlushMemoryThreshold = 4 * 1024 * 1024;
+
+	/*
+	 * Flushes are pushed back while frames take longer than this, e.g.: during hitches and map loads
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "ms"))
+	float FlushFrameBudget = 50.0f;
+
+	/*
+	 * Longest time a flush can be pushed back because of slow frames
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "s"))
+	float MaxFlushDeferral = 10.0f;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay)
+	ECtcAnalyticsWireFormat WireFormat = ECtcAnalyticsWireFormat::PerEvent;
+
+	/*
+	 * Whether created_at is sent with microseconds instead of milliseconds
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay)
+	bool bHighPrecisionTimestamps = false;
+
+	/*
+	 * Whether numbers, booleans and JSON fragments are sent as native JSON values instead of strings. Requires a backend
+	 * accepting typed event properties
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay)
+	bool bTypedAttributeValues = false;
+
+	/*
+	 * Whether every request carries its position among the requests of the session, letting the backend spot the missing
+	 * ones. Requires a backend accepting the sequence field
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay)
+	bool bSendBatchSequence = false;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay)
+	ECtcAnalyticsCompression Compression = ECtcAnalyticsCompression::None;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (EditCondition = "Compression != ECtcAnalyticsCompression::None", ClampMin = 1, ClampMax = 22))
+	int32 CompressionLevel = 6;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 1))
+	int32 MaxInFlightRequests = 2;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 1))
+	int32 MaxSendAttempts = 5;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "s"))
+	float RetryBaseDelay = 2.0f;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "s"))
+	float RetryMaxDelay = 300.0f;
+
+	/*
+	 * Amount of data waiting to be sent after which new events are dropped
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "Bytes"))
+	int64 MaxSendBacklogSize = 32 * 1024 * 1024;
+
+	/*
+	 * Maximum size of a single request body before compression. Bigger batches are split in several requests
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 1024, Units = "Bytes"))
+	int64 MaxBatchSize = 1024 * 1024;
+
+	/*
+	 * Maximum number of events sent in a single request. Bigger batches are split in several requests
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 1))
+	int32 MaxBatchEvents = 5000;
+
+	/*
+	 * Memory the events waiting for the next flush can take before the overflow policy kicks in
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "Bytes"))
+	int64 MaxCachedEventsMemory = 16 * 1024 * 1024;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay)
+	ECtcAnalyticsOverflowPolicy OverflowPolicy = ECtcAnalyticsOverflowPolicy::DropOldest;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (EditCondition = "OverflowPolicy == ECtcAnalyticsOverflowPolicy::Downsample", ClampMin = 2))
+	int32 DownsampleRate = 10;
+
+	/*
+	 * Amount of data the spill file can hold until the next flush, events overflowing it are dropped
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (EditCondition = "OverflowPolicy == ECtcAnalyticsOverflowPolicy::SpillToDisk", ClampMin = 0, Units = "Bytes"))
+	int64 MaxSpillFileSize = 256 * 1024 * 1024;
+
+	/*
+	 * Disk space the batches waiting to be sent can take, across runs. The oldest batches are deleted past it
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "Bytes"))
+	int64 MaxOutboxSize = 64 * 1024 * 1024;
+
+	/*
+	 * Age after which batches left by previous runs are deleted instead of being sent. 0 keeps them until they're sent
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "s"))
+	float MaxOutboxSegmentAge = 7.0f * 24.0f * 60.0f * 60.0f;
+
+	/*
+	 * Longest time sending the last events can delay the exit or the end of PIE. What isn't sent by then goes out on the next launch
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "s"))
+	float ShutdownFlushTimeout = 3.0f;
+
+	/*
+	 * Memory reserved upfront to persist the pending events when the application crashes. Events which don't fit are lost
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending", AdvancedDisplay, meta = (ClampMin = 0, Units = "Bytes", ConfigRestartRequired = true))
+	int32 CrashBufferSize = 1024 * 1024;
+
+	/*
+	 * Events sent right away in small batches of their own instead of waiting for the next flush. Never sampled nor rate limited
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sending")
+	TSet<FString> CriticalEvents = {TEXT("SessionStart"), TEXT("SessionEnd"), TEXT("SystemError"), TEXT("ApplicationWillTerminate"), TEXT("EngineExit"), TEXT("ALT+F4 Pressed")};
+
+	/*
+	 * Sampling and rate limits of specific events, by event name
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sampling")
+	TMap<FString, FCtcAnalyticsEventSampling> EventSampling;
+
+	/*
+	 * Sampling of the events not listed in EventSampling. Rate limits only apply to listed events, MaxEventsPerSecond is ignored here
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Analytics|Sampling")
+	FCtcAnalyticsEventSampling DefaultEventSampling;
+
 	UPROPERTY(Config, BlueprintReadOnly, Category = "Analytics|Attribution")
 	FString PlatformAttribution = TEXT("");
 
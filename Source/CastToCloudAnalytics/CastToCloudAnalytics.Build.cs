@@ -28,9 +28,17 @@ public class CastToCloudAnalytics : ModuleRules
 			}
 		);
 
+		AddEngineThirdPartyPrivateStaticDependencies(Target, "zlib");
+
 		if (Target.bBuildEditor)
 		{
 			PublicDependencyModuleNames.Add("UnrealEd");
 		}
+
+		// Automation tests stand in for the backend with a local HTTP server
+		if (Target.Configuration != UnrealTargetConfiguration.Shipping)
+		{
+			PrivateDependencyModuleNames.Add("HTTPServer");
+		}
 	}
 }
@@ -2,7 +2,6 @@
 
 #include "CtcAnalyticsBPFL.h"
 
-#include "CtcAnalyticsModule.h"
 #include "CtcAnalyticsProvider.h"
 
 // Stolen from AnalyticsBlueprintLibrary.cpp
@@ -22,12 +21,16 @@ namespace
 
 void UCtcAnalyticsBPFL::RecordEventAtLocationBP(const FString& EventName, const FVector& Location, const FQuat& Rotation, const TArray<FAnalyticsEventAttr>& Attributes)
 {
-	RecordEventAtLocation(EventName, Location, Rotation, ConvertAttrs(Attributes));
+	// NOTE: Nothing is converted unless the event is going to be recorded
+	if (FCtcAnalyticsProvider* CtcProvider = FCtcAnalyticsProvider::GetActive())
+	{
+		CtcProvider->RecordEventWithTransform(EventName, FTransform(Rotation, Location), ConvertAttrs(Attributes));
+	}
 }
 
 void UCtcAnalyticsBPFL::RecordEventAtLocation(const FString& EventName, const FVector& Location, const FQuat& Rotation, const TArray<FAnalyticsEventAttribute>& Attributes)
 {
-	if (TSharedPtr<FCtcAnalyticsProvider> CtcProvider = FCtcAnalyticsModule::Get().GetProvider())
+	if (FCtcAnalyticsProvider* CtcProvider = FCtcAnalyticsProvider::GetActive())
 	{
 		FTransform EventTransform = FTransform(Rotation, Location);
 		CtcProvider->RecordEventWithTransform(EventName, EventTransform, Attributes);
@@ -36,12 +39,15 @@ void UCtcAnalyticsBPFL::RecordEventAtLocation(const FString& EventName, const FV
 
 void UCtcAnalyticsBPFL::RecordEventWithTransformBP(const FString& EventName, const FTransform& Transform, const TArray<FAnalyticsEventAttr>& Attributes)
 {
-	RecordEventWithTransform(EventName, Transform, ConvertAttrs(Attributes));
+	if (FCtcAnalyticsProvider* CtcProvider = FCtcAnalyticsProvider::GetActive())
+	{
+		CtcProvider->RecordEventWithTransform(EventName, Transform, ConvertAttrs(Attributes));
+	}
 }
 
 void UCtcAnalyticsBPFL::RecordEventWithTransform(const FString& EventName, const FTransform& Transform, const TArray<FAnalyticsEventAttribute>& Attributes)
 {
-	if (TSharedPtr<FCtcAnalyticsProvider> CtcProvider = FCtcAnalyticsModule::Get().GetProvider())
+	if (FCtcAnalyticsProvider* CtcProvider = FCtcAnalyticsProvider::GetActive())
 	{
 		CtcProvider->RecordEventWithTransform(EventName, Transform, Attributes);
 	}
@@ -49,7 +55,7 @@ void UCtcAnalyticsBPFL::RecordEventWithTransform(const FString& EventName, const
 
 void UCtcAnalyticsBPFL::RecordEventWithOptionalTransform(const FString& EventName, TOptional<FTransform> Transform, const TArray<FAnalyticsEventAttribute>& Attributes)
 {
-	if (TSharedPtr<FCtcAnalyticsProvider> CtcProvider = FCtcAnalyticsModule::Get().GetProvider())
+	if (FCtcAnalyticsProvider* CtcProvider = FCtcAnalyticsProvider::GetActive())
 	{
 		if (Transform.IsSet())
 		{
@@ -0,0 +1,102 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsCompression.h"
+
+#include <Misc/Compression.h>
+
+THIRD_PARTY_INCLUDES_START
+#include <zlib.h>
+THIRD_PARTY_INCLUDES_END
+
+#include "CtcAnalyticsLog.h"
+
+namespace
+{
+	const FName ZstdFormatName = TEXT("Zstd");
+
+	bool CompressGzip(int32 Level, TConstArrayView<uint8> Input, TArray<uint8>& OutCompressed)
+	{
+		z_stream Stream;
+		FMemory::Memzero(Stream);
+
+		// NOTE: Adding 16 to the window bits makes zlib write a gzip header and trailer instead of the zlib ones
+		if (deflateInit2(&Stream, FMath::Clamp(Level, Z_BEST_SPEED, Z_BEST_COMPRESSION), Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			return false;
+		}
+
+		OutCompressed.SetNumUninitialized(deflateBound(&Stream, Input.Num()));
+
+		Stream.next_in = const_cast<Bytef*>(Input.GetData());
+		Stream.avail_in = Input.Num();
+		Stream.next_out = OutCompressed.GetData();
+		Stream.avail_out = OutCompressed.Num();
+
+		const int32 Result = deflate(&Stream, Z_FINISH);
+		deflateEnd(&Stream);
+
+		if (Result != Z_STREAM_END)
+		{
+			return false;
+		}
+
+		OutCompressed.SetNum(Stream.total_out, EAllowShrinking::No);
+		return true;
+	}
+
+	bool CompressZstd(int32 Level, TConstArrayView<uint8> Input, TArray<uint8>& OutCompressed)
+	{
+		int32 CompressedSize = FCompression::CompressMemoryBound(ZstdFormatName, Input.Num());
+		OutCompressed.SetNumUninitialized(CompressedSize);
+
+		if (!FCompression::CompressMemory(ZstdFormatName, OutCompressed.GetData(), CompressedSize, Input.GetData(), Input.Num(), COMPRESS_NoFlags, Level))
+		{
+			return false;
+		}
+
+		OutCompressed.SetNum(CompressedSize, EAllowShrinking::No);
+		return true;
+	}
+} // namespace
+
+ECtcAnalyticsCompression FCtcAnalyticsCompression::Compress(ECtcAnalyticsCompression Method, int32 Level, TConstArrayView<uint8> Input, TArray<uint8>& OutCompressed)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsCompression::Compress);
+
+	if (Method == ECtcAnalyticsCompression::Zstd && !FCompression::IsFormatValid(ZstdFormatName))
+	{
+		UE_LOG(LogCtcAnalytics, Verbose, TEXT("No Zstd compression format is registered. Falling back to Gzip."));
+		Method = ECtcAnalyticsCompression::Gzip;
+	}
+
+	bool bCompressed = false;
+	if (Method == ECtcAnalyticsCompression::Gzip)
+	{
+		bCompressed = CompressGzip(Level, Input, OutCompressed);
+	}
+	else if (Method == ECtcAnalyticsCompression::Zstd)
+	{
+		bCompressed = CompressZstd(Level, Input, OutCompressed);
+	}
+
+	if (!bCompressed || OutCompressed.Num() >= Input.Num())
+	{
+		OutCompressed.Reset();
+		return ECtcAnalyticsCompression::None;
+	}
+
+	return Method;
+}
+
+const TCHAR* FCtcAnalyticsCompression::GetContentEncoding(ECtcAnalyticsCompression Method)
+{
+	switch (Method)
+	{
+	case ECtcAnalyticsCompression::Gzip:
+		return TEXT("gzip");
+	case ECtcAnalyticsCompression::Zstd:
+		return TEXT("zstd");
+	default:
+		return TEXT("identity");
+	}
+}
@@ -0,0 +1,99 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsEventArena.h"
+
+FCtcAnalyticsEventArena::~FCtcAnalyticsEventArena()
+{
+	Reset(true);
+}
+
+void* FCtcAnalyticsEventArena::Allocate(SIZE_T Size, SIZE_T Alignment)
+{
+	// NOTE: Blocks only guarantee BlockAlignment, stricter alignments are reached by padding the allocation
+	const SIZE_T PaddedSize = Align(Size + (Alignment > BlockAlignment ? Alignment - BlockAlignment : 0), BlockAlignment);
+
+	for (;;)
+	{
+		FBlock* Block = CurrentBlock.load(std::memory_order_acquire);
+		if (Block)
+		{
+			const SIZE_T Offset = Block->Used.fetch_add(PaddedSize, std::memory_order_relaxed);
+			if (Offset + PaddedSize <= Block->Capacity)
+			{
+				return Align(Block->Data + Offset, Alignment);
+			}
+		}
+
+		if (void* Memory = AllocateSlow(Block, PaddedSize, Alignment))
+		{
+			return Memory;
+		}
+	}
+}
+
+void FCtcAnalyticsEventArena::Reset(bool bReleaseMemory)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	for (FBlock* Block : LargeBlocks)
+	{
+		DeleteBlock(Block);
+	}
+	LargeBlocks.Reset();
+
+	// Blocks which weren't needed since the last reset are given back, the rest is kept for the next round
+	const int32 NumKeptBlocks = bReleaseMemory ? 0 : CurrentBlockIndex + 1;
+	for (int32 Index = NumKeptBlocks; Index < Blocks.Num(); ++Index)
+	{
+		DeleteBlock(Blocks[Index]);
+	}
+	Blocks.SetNum(NumKeptBlocks);
+
+	for (FBlock* Block : Blocks)
+	{
+		Block->Used.store(0, std::memory_order_relaxed);
+	}
+
+	CurrentBlockIndex = Blocks.IsEmpty() ? INDEX_NONE : 0;
+	CurrentBlock.store(Blocks.IsEmpty() ? nullptr : Blocks[0], std::memory_order_release);
+}
+
+void* FCtcAnalyticsEventArena::AllocateSlow(FBlock* FullBlock, SIZE_T Size, SIZE_T Alignment)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	if (Size > BlockSize)
+	{
+		FBlock* Block = NewBlock(Size);
+		Block->Used.store(Size, std::memory_order_relaxed);
+		LargeBlocks.Add(Block);
+		return Align(Block->Data, Alignment);
+	}
+
+	// Another thread might have moved to the next block already
+	if (CurrentBlock.load(std::memory_order_relaxed) == FullBlock)
+	{
+		++CurrentBlockIndex;
+		if (CurrentBlockIndex == Blocks.Num())
+		{
+			Blocks.Add(NewBlock(BlockSize));
+		}
+		CurrentBlock.store(Blocks[CurrentBlockIndex], std::memory_order_release);
+	}
+
+	return nullptr;
+}
+
+FCtcAnalyticsEventArena::FBlock* FCtcAnalyticsEventArena::NewBlock(SIZE_T Capacity)
+{
+	FBlock* Block = new FBlock();
+	Block->Data = static_cast<uint8*>(FMemory::Malloc(Capacity, BlockAlignment));
+	Block->Capacity = Capacity;
+	return Block;
+}
+
+void FCtcAnalyticsEventArena::DeleteBlock(FBlock* Block)
+{
+	FMemory::Free(Block->Data);
+	delete Block;
+}
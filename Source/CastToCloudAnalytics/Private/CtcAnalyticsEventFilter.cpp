@@ -0,0 +1,147 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsEventFilter.h"
+
+#include "CtcAnalyticsLog.h"
+
+FCtcAnalyticsEventFilter::FCtcAnalyticsEventFilter()
+{
+	Snapshot.store(Snapshots.Add_GetRef(MakeUnique<FSnapshot>()).Get(), std::memory_order_release);
+}
+
+FCtcAnalyticsEventFilter::~FCtcAnalyticsEventFilter() = default;
+
+void FCtcAnalyticsEventFilter::Configure(const UCtcSharedSettings& Settings)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsEventFilter::Configure);
+
+	FScopeLock ScopeLock(&ConfigureLock);
+
+	// NOTE: Replaced snapshots can't be freed, only build a new one when there's something new to compile
+	if (Settings.EventSampling.OrderIndependentCompareEqual(ConfiguredEventSampling)
+		&& Settings.DefaultEventSampling == ConfiguredDefaultEventSampling
+		&& Settings.CriticalEvents.Num() == ConfiguredCriticalEvents.Num() && Settings.CriticalEvents.Includes(ConfiguredCriticalEvents))
+	{
+		return;
+	}
+
+	ConfiguredEventSampling = Settings.EventSampling;
+	ConfiguredDefaultEventSampling = Settings.DefaultEventSampling;
+	ConfiguredCriticalEvents = Settings.CriticalEvents;
+
+	TUniquePtr<FSnapshot> NewSnapshot = MakeUnique<FSnapshot>();
+
+	int32 NumBuckets = 0;
+	for (const TPair<FString, FCtcAnalyticsEventSampling>& Sampling : Settings.EventSampling)
+	{
+		NewSnapshot->Rules.Add(Sampling.Key, CompileRule(Sampling.Value, NumBuckets));
+	}
+
+	// NOTE: A single bucket shared by every unlisted event would let a noisy one starve all the others, only listed events are rate limited
+	NewSnapshot->DefaultRule.SampleRate = Settings.DefaultEventSampling.SampleRate;
+
+	NewSnapshot->bCanReject = NewSnapshot->DefaultRule.SampleRate < 1.0f;
+	for (const TPair<FString, FRule>& Rule : NewSnapshot->Rules)
+	{
+		NewSnapshot->bCanReject |= Rule.Value.SampleRate < 1.0f || Rule.Value.BucketIndex != INDEX_NONE;
+	}
+
+	NewSnapshot->ArrivalTimes = MakeUnique<std::atomic<double>[]>(NumBuckets);
+	for (int32 BucketIndex = 0; BucketIndex < NumBuckets; ++BucketIndex)
+	{
+		NewSnapshot->ArrivalTimes[BucketIndex].store(0.0, std::memory_order_relaxed);
+	}
+
+	NewSnapshot->CriticalEventNames.Append(Settings.CriticalEvents);
+
+	// NOTE: The previous snapshot stays alive, threads checking an event right now may still be reading it
+	Snapshot.store(Snapshots.Add_GetRef(MoveTemp(NewSnapshot)).Get(), std::memory_order_release);
+}
+
+void FCtcAnalyticsEventFilter::SetSessionId(const FString& SessionId)
+{
+	SessionIdHash.store(GetTypeHash(SessionId), std::memory_order_relaxed);
+}
+
+FCtcAnalyticsEventFilter::EResult FCtcAnalyticsEventFilter::Check(FStringView EventName) const
+{
+	const FSnapshot& CurrentSnapshot = *Snapshot.load(std::memory_order_acquire);
+	if (!CurrentSnapshot.bCanReject)
+	{
+		return EResult::Pass;
+	}
+
+	// NOTE: Looked up by hash, the name doesn't have to be copied into an FString. Both hashes ignore case
+	uint32 EventNameHash = GetTypeHash(EventName);
+	const FRule* Rule = CurrentSnapshot.Rules.FindByHash(EventNameHash, EventName);
+	if (!Rule)
+	{
+		// Unlisted events are sampled together, a session either records all of them or none
+		Rule = &CurrentSnapshot.DefaultRule;
+		EventNameHash = GetTypeHash(FStringView());
+	}
+
+	if (!IsSampledIn(*Rule, EventNameHash))
+	{
+		return EResult::SampledOut;
+	}
+
+	if (Rule->BucketIndex == INDEX_NONE)
+	{
+		return EResult::Pass;
+	}
+
+	return ConsumeToken(*Rule, CurrentSnapshot.ArrivalTimes[Rule->BucketIndex]) ? EResult::Pass : EResult::RateLimited;
+}
+
+bool FCtcAnalyticsEventFilter::IsCritical(FStringView EventName) const
+{
+	const FSnapshot& CurrentSnapshot = *Snapshot.load(std::memory_order_acquire);
+	return !CurrentSnapshot.CriticalEventNames.IsEmpty() && CurrentSnapshot.CriticalEventNames.ContainsByHash(GetTypeHash(EventName), EventName);
+}
+
+FCtcAnalyticsEventFilter::FRule FCtcAnalyticsEventFilter::CompileRule(const FCtcAnalyticsEventSampling& Sampling, int32& NumBuckets)
+{
+	FRule Rule;
+	Rule.SampleRate = Sampling.SampleRate;
+
+	// Events are spaced by the emission interval, up to MaxBurst of them can arrive ahead of their time
+	if (Sampling.MaxEventsPerSecond > 0.0f)
+	{
+		Rule.BucketIndex = NumBuckets++;
+		Rule.EmissionInterval = 1.0 / Sampling.MaxEventsPerSecond;
+		Rule.BurstTolerance = (FMath::Max(Sampling.MaxBurst, 1) - 1) * Rule.EmissionInterval;
+	}
+
+	return Rule;
+}
+
+bool FCtcAnalyticsEventFilter::IsSampledIn(const FRule& Rule, uint32 EventNameHash) const
+{
+	if (Rule.SampleRate >= 1.0f)
+	{
+		return true;
+	}
+
+	// NOTE: The decision only depends on the session and the event name, it stays the same for the whole session and across restarts
+	const uint32 Hash = HashCombine(SessionIdHash.load(std::memory_order_relaxed), EventNameHash);
+	return static_cast<double>(Hash) / static_cast<double>(MAX_uint32) < Rule.SampleRate;
+}
+
+bool FCtcAnalyticsEventFilter::ConsumeToken(const FRule& Rule, std::atomic<double>& ArrivalTime)
+{
+	const double Now = FPlatformTime::Seconds();
+	double TheoreticalArrivalTime = ArrivalTime.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		if (TheoreticalArrivalTime - Now > Rule.BurstTolerance)
+		{
+			return false;
+		}
+
+		if (ArrivalTime.compare_exchange_weak(TheoreticalArrivalTime, FMath::Max(TheoreticalArrivalTime, Now) + Rule.EmissionInterval, std::memory_order_relaxed))
+		{
+			return true;
+		}
+	}
+}
@@ -0,0 +1,110 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsFileSink.h"
+
+#include <GenericPlatform/GenericPlatformFile.h>
+#include <HAL/PlatformFileManager.h>
+
+#include "CtcAnalyticsLog.h"
+
+FCtcAnalyticsFileSink::FCtcAnalyticsFileSink(const FString& InDirectory) : Directory(InDirectory)
+{
+}
+
+FCtcAnalyticsFileSink::~FCtcAnalyticsFileSink()
+{
+	Close();
+}
+
+void FCtcAnalyticsFileSink::Append(const FString& SessionId, TArray<uint8>&& Lines)
+{
+	if (Lines.IsEmpty())
+	{
+		return;
+	}
+
+	// Keep the memory bounded if the disk can't keep up with the events
+	if (PendingBytes.load(std::memory_order_relaxed) > MaxPendingBytes)
+	{
+		WritePipe.WaitUntilEmpty();
+	}
+
+	PendingBytes.fetch_add(Lines.Num(), std::memory_order_relaxed);
+	WritePipe.Launch(
+		UE_SOURCE_LOCATION,
+		[this, SessionId, Lines = MoveTemp(Lines)]()
+		{
+			WriteLines(SessionId, Lines);
+			PendingBytes.fetch_sub(Lines.Num(), std::memory_order_relaxed);
+		}
+	);
+}
+
+void FCtcAnalyticsFileSink::WaitForPendingWrites()
+{
+	WritePipe.WaitUntilEmpty();
+}
+
+void FCtcAnalyticsFileSink::Close()
+{
+	WritePipe.Launch(
+		UE_SOURCE_LOCATION,
+		[this]()
+		{
+			CloseFile();
+		}
+	);
+	WritePipe.WaitUntilEmpty();
+}
+
+void FCtcAnalyticsFileSink::WriteLines(const FString& SessionId, const TArray<uint8>& Lines)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsFileSink::WriteLines);
+
+	if (FileHandle && FileSessionId != SessionId)
+	{
+		CloseFile();
+	}
+
+	if (FileHandle && FileHandle->Size() > 0 && FileHandle->Size() + Lines.Num() > MaxFileSize)
+	{
+		CloseFile();
+		++FileIndex;
+	}
+
+	if (!FileHandle)
+	{
+		if (FileSessionId != SessionId)
+		{
+			FileSessionId = SessionId;
+			FileIndex = 0;
+		}
+
+		const FString FileName = FileIndex == 0 ? FileSessionId : FString::Printf(TEXT("%s.%d"), *FileSessionId, FileIndex);
+		const FString FilePath = Directory / FileName + TEXT(".ndjson");
+
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		PlatformFile.CreateDirectoryTree(*Directory);
+		FileHandle.Reset(PlatformFile.OpenWrite(*FilePath, true, true));
+
+		if (!FileHandle)
+		{
+			UE_LOG(LogCtcAnalytics, Error, TEXT("Failed to open %s. Dropping %d bytes of events."), *FilePath, Lines.Num());
+			return;
+		}
+	}
+
+	if (!FileHandle->Write(Lines.GetData(), Lines.Num()))
+	{
+		UE_LOG(LogCtcAnalytics, Error, TEXT("Failed to write %d bytes of events for session %s."), Lines.Num(), *SessionId);
+	}
+}
+
+void FCtcAnalyticsFileSink::CloseFile()
+{
+	if (FileHandle)
+	{
+		FileHandle->Flush(true);
+		FileHandle.Reset();
+	}
+}
@@ -0,0 +1,275 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsJsonEncoder.h"
+
+namespace
+{
+	void AppendAnsi(TArray<uint8>& OutBuffer, const ANSICHAR* Chars, int32 Length)
+	{
+		OutBuffer.Append(reinterpret_cast<const uint8*>(Chars), Length);
+	}
+
+	void AppendCodepoint(TArray<uint8>& OutBuffer, uint32 Codepoint)
+	{
+		if (Codepoint < 0x80)
+		{
+			OutBuffer.Add(static_cast<uint8>(Codepoint));
+		}
+		else if (Codepoint < 0x800)
+		{
+			OutBuffer.Add(static_cast<uint8>(0xC0 | (Codepoint >> 6)));
+			OutBuffer.Add(static_cast<uint8>(0x80 | (Codepoint & 0x3F)));
+		}
+		else if (Codepoint < 0x10000)
+		{
+			OutBuffer.Add(static_cast<uint8>(0xE0 | (Codepoint >> 12)));
+			OutBuffer.Add(static_cast<uint8>(0x80 | ((Codepoint >> 6) & 0x3F)));
+			OutBuffer.Add(static_cast<uint8>(0x80 | (Codepoint & 0x3F)));
+		}
+		else
+		{
+			OutBuffer.Add(static_cast<uint8>(0xF0 | (Codepoint >> 18)));
+			OutBuffer.Add(static_cast<uint8>(0x80 | ((Codepoint >> 12) & 0x3F)));
+			OutBuffer.Add(static_cast<uint8>(0x80 | ((Codepoint >> 6) & 0x3F)));
+			OutBuffer.Add(static_cast<uint8>(0x80 | (Codepoint & 0x3F)));
+		}
+	}
+	/**
+	 * Reads the codepoint at Index, combining UTF-16 surrogate pairs. Unpaired surrogates are read as the replacement character
+	 */
+	uint32 ReadCodepoint(const TCHAR* Chars, int32 Length, int32& Index)
+	{
+		const uint32 Codepoint = static_cast<uint32>(Chars[Index]);
+		if (sizeof(TCHAR) != 2 || Codepoint < 0xD800 || Codepoint > 0xDFFF)
+		{
+			return Codepoint;
+		}
+
+		const uint32 NextCodepoint = Index + 1 < Length ? static_cast<uint32>(Chars[Index + 1]) : 0;
+		if (Codepoint <= 0xDBFF && NextCodepoint >= 0xDC00 && NextCodepoint <= 0xDFFF)
+		{
+			++Index;
+			return 0x10000 + ((Codepoint - 0xD800) << 10) + (NextCodepoint - 0xDC00);
+		}
+
+		return 0xFFFD;
+	}
+} // namespace
+
+FCtcAnalyticsJsonEncoder::FCtcAnalyticsJsonEncoder(TArray<uint8>& InBuffer, bool bAfterValue) : Buffer(InBuffer), bNeedsSeparator(bAfterValue)
+{
+}
+
+void FCtcAnalyticsJsonEncoder::BeginObject()
+{
+	WriteSeparator();
+	Buffer.Add('{');
+	bNeedsSeparator = false;
+}
+
+void FCtcAnalyticsJsonEncoder::EndObject()
+{
+	Buffer.Add('}');
+	bNeedsSeparator = true;
+}
+
+void FCtcAnalyticsJsonEncoder::BeginArray()
+{
+	WriteSeparator();
+	Buffer.Add('[');
+	bNeedsSeparator = false;
+}
+
+void FCtcAnalyticsJsonEncoder::EndArray()
+{
+	Buffer.Add(']');
+	bNeedsSeparator = true;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteKey(FStringView Key)
+{
+	WriteSeparator();
+	AppendEscapedString(Buffer, Key);
+	Buffer.Add(':');
+	bNeedsSeparator = false;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteEscapedKey(TConstArrayView<uint8> EscapedKey)
+{
+	WriteSeparator();
+	Buffer.Append(EscapedKey.GetData(), EscapedKey.Num());
+	Buffer.Add(':');
+	bNeedsSeparator = false;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteString(FStringView Value)
+{
+	WriteSeparator();
+	AppendEscapedString(Buffer, Value);
+	bNeedsSeparator = true;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteNumber(double Value)
+{
+	WriteSeparator();
+
+	// NOTE: Same precision used by TJsonWriter, enough to round-trip any double
+	ANSICHAR Chars[32];
+	const int32 Length = FCStringAnsi::Snprintf(Chars, UE_ARRAY_COUNT(Chars), "%.17g", Value);
+	AppendAnsi(Buffer, Chars, FMath::Clamp(Length, 0, UE_ARRAY_COUNT(Chars) - 1));
+
+	bNeedsSeparator = true;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteInteger(int64 Value)
+{
+	WriteSeparator();
+
+	ANSICHAR Chars[24];
+	const int32 Length = FCStringAnsi::Snprintf(Chars, UE_ARRAY_COUNT(Chars), "%lld", static_cast<long long>(Value));
+	AppendAnsi(Buffer, Chars, FMath::Clamp(Length, 0, UE_ARRAY_COUNT(Chars) - 1));
+
+	bNeedsSeparator = true;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteBool(bool bValue)
+{
+	WriteSeparator();
+	if (bValue)
+	{
+		AppendAnsi(Buffer, "true", 4);
+	}
+	else
+	{
+		AppendAnsi(Buffer, "false", 5);
+	}
+	bNeedsSeparator = true;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteDateTime(const FDateTime& Value, bool bMicroseconds)
+{
+	WriteSeparator();
+
+	// NOTE: Same output as FDateTime::ToIso8601 without going through an intermediate FString
+	ANSICHAR Chars[40];
+	int32 Length;
+	if (bMicroseconds)
+	{
+		const int32 Microsecond = static_cast<int32>(Value.GetTicks() % ETimespan::TicksPerSecond / ETimespan::TicksPerMicrosecond);
+		Length = FCStringAnsi::Snprintf(Chars, UE_ARRAY_COUNT(Chars), "\"%04d-%02d-%02dT%02d:%02d:%02d.%06dZ\"", Value.GetYear(), Value.GetMonth(), Value.GetDay(), Value.GetHour(), Value.GetMinute(), Value.GetSecond(), Microsecond);
+	}
+	else
+	{
+		Length = FCStringAnsi::Snprintf(Chars, UE_ARRAY_COUNT(Chars), "\"%04d-%02d-%02dT%02d:%02d:%02d.%03dZ\"", Value.GetYear(), Value.GetMonth(), Value.GetDay(), Value.GetHour(), Value.GetMinute(), Value.GetSecond(), Value.GetMillisecond());
+	}
+	AppendAnsi(Buffer, Chars, FMath::Clamp(Length, 0, UE_ARRAY_COUNT(Chars) - 1));
+
+	bNeedsSeparator = true;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteRaw(TConstArrayView<uint8> Bytes)
+{
+	if (Bytes.IsEmpty())
+	{
+		return;
+	}
+
+	WriteSeparator();
+	Buffer.Append(Bytes.GetData(), Bytes.Num());
+	bNeedsSeparator = true;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteRaw(FStringView Json)
+{
+	if (Json.IsEmpty())
+	{
+		return;
+	}
+
+	WriteSeparator();
+
+	const TCHAR* Chars = Json.GetData();
+	const int32 Length = Json.Len();
+	for (int32 Index = 0; Index < Length; ++Index)
+	{
+		AppendCodepoint(Buffer, ReadCodepoint(Chars, Length, Index));
+	}
+
+	bNeedsSeparator = true;
+}
+
+void FCtcAnalyticsJsonEncoder::WriteStringField(FStringView Key, FStringView Value)
+{
+	WriteKey(Key);
+	WriteString(Value);
+}
+
+void FCtcAnalyticsJsonEncoder::WriteNumberField(FStringView Key, double Value)
+{
+	WriteKey(Key);
+	WriteNumber(Value);
+}
+
+void FCtcAnalyticsJsonEncoder::WriteBoolField(FStringView Key, bool bValue)
+{
+	WriteKey(Key);
+	WriteBool(bValue);
+}
+
+void FCtcAnalyticsJsonEncoder::AppendEscapedString(TArray<uint8>& OutBuffer, FStringView Value)
+{
+	OutBuffer.Add('"');
+
+	const TCHAR* Chars = Value.GetData();
+	const int32 Length = Value.Len();
+	for (int32 Index = 0; Index < Length; ++Index)
+	{
+		const uint32 Codepoint = static_cast<uint32>(Chars[Index]);
+		switch (Codepoint)
+		{
+		case '\"':
+			AppendAnsi(OutBuffer, "\\\"", 2);
+			continue;
+		case '\\':
+			AppendAnsi(OutBuffer, "\\\\", 2);
+			continue;
+		case '\n':
+			AppendAnsi(OutBuffer, "\\n", 2);
+			continue;
+		case '\t':
+			AppendAnsi(OutBuffer, "\\t", 2);
+			continue;
+		case '\b':
+			AppendAnsi(OutBuffer, "\\b", 2);
+			continue;
+		case '\f':
+			AppendAnsi(OutBuffer, "\\f", 2);
+			continue;
+		case '\r':
+			AppendAnsi(OutBuffer, "\\r", 2);
+			continue;
+		default:
+			break;
+		}
+
+		if (Codepoint <= 0x1F)
+		{
+			ANSICHAR Escaped[8];
+			FCStringAnsi::Snprintf(Escaped, UE_ARRAY_COUNT(Escaped), "\\u%04x", Codepoint);
+			AppendAnsi(OutBuffer, Escaped, 6);
+			continue;
+		}
+
+		AppendCodepoint(OutBuffer, ReadCodepoint(Chars, Length, Index));
+	}
+
+	OutBuffer.Add('"');
+}
+
+void FCtcAnalyticsJsonEncoder::WriteSeparator()
+{
+	if (bNeedsSeparator)
+	{
+		Buffer.Add(',');
+	}
+}
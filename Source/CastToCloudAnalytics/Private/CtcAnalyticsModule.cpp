@@ -2,6 +2,7 @@
 
 #include "CtcAnalyticsModule.h"
 
+#include "CtcAnalyticsMacros.h"
 #include "CtcAnalyticsProvider.h"
 
 FCtcAnalyticsModule& FCtcAnalyticsModule::Get()
@@ -11,7 +12,9 @@ FCtcAnalyticsModule& FCtcAnalyticsModule::Get()
 
 void FCtcAnalyticsModule::StartupModule()
 {
+#if CTC_ANALYTICS_ENABLED
 	AnalyticsProvider = MakeShared<FCtcAnalyticsProvider>();
+#endif
 }
 
 void FCtcAnalyticsModule::ShutdownModule()
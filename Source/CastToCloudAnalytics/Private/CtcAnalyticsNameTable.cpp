@@ -0,0 +1,130 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsNameTable.h"
+
+#include <Misc/Crc.h>
+
+#include "CtcAnalyticsJsonEncoder.h"
+#include "CtcAnalyticsLog.h"
+
+namespace
+{
+	/**
+	 * Recently interned names of the current thread. Direct mapped, a name only evicts the one sharing its slot
+	 */
+	struct FLookupCacheEntry
+	{
+		uint32 TableId = 0;
+		uint32 Hash = 0;
+		int32 Id = 0;
+	};
+
+	constexpr int32 NumLookupCacheEntries = 256;
+
+	thread_local FLookupCacheEntry LookupCache[NumLookupCacheEntries];
+
+	std::atomic<uint32> NextTableId = 1;
+} // namespace
+
+FCtcAnalyticsNameTable::FCtcAnalyticsNameTable() : TableId(NextTableId.fetch_add(1, std::memory_order_relaxed))
+{
+	verify(InternLocked(FStringView()) == EmptyId);
+}
+
+int32 FCtcAnalyticsNameTable::Intern(FStringView Name)
+{
+	// NOTE: A hit is verified against the entry, which can be read without the lock once its ID is known
+	const uint32 Hash = FCrc::MemCrc32(Name.GetData(), Name.Len() * sizeof(TCHAR));
+	FLookupCacheEntry& CacheEntry = LookupCache[Hash % NumLookupCacheEntries];
+	if (CacheEntry.TableId == TableId && CacheEntry.Hash == Hash && GetEntry(CacheEntry.Id).Name.Equals(Name, ESearchCase::CaseSensitive))
+	{
+		return CacheEntry.Id;
+	}
+
+	const int32 Id = InternLocked(Name);
+
+	// Names which didn't fit aren't cached, they have no entry to verify a hit against
+	if (Id != INDEX_NONE)
+	{
+		CacheEntry = {TableId, Hash, Id};
+	}
+	return Id;
+}
+
+int32 FCtcAnalyticsNameTable::InternLocked(FStringView Name)
+{
+	{
+		FReadScopeLock ReadLock(Lock);
+		if (const int32* ExistingId = Ids.Find(Name))
+		{
+			return *ExistingId;
+		}
+	}
+
+	// NOTE: Once the table is full, new names don't wait for the write lock
+	if (NumEntries.load(std::memory_order_relaxed) >= MaxBlocks * BlockSize)
+	{
+		return RejectName(Name);
+	}
+
+	FWriteScopeLock WriteLock(Lock);
+
+	// Another thread might have added it while the lock was released
+	if (const int32* ExistingId = Ids.Find(Name))
+	{
+		return *ExistingId;
+	}
+
+	const int32 Id = NumEntries.load(std::memory_order_relaxed);
+	if (Id >= MaxBlocks * BlockSize)
+	{
+		return RejectName(Name);
+	}
+
+	TUniquePtr<FEntry[]>& Block = Blocks[Id / BlockSize];
+	if (!Block)
+	{
+		Block = MakeUnique<FEntry[]>(BlockSize);
+	}
+
+	FEntry& Entry = Block[Id % BlockSize];
+	Entry.Name = FString(Name);
+	FCtcAnalyticsJsonEncoder::AppendEscapedString(Entry.EscapedName, Name);
+	Entry.FoldedId = FoldedIds.FindOrAdd(Entry.Name, Id);
+	Ids.Add(Entry.Name, Id);
+
+	// NOTE: Publishes the entry to the readers, which only get the ID afterwards
+	NumEntries.store(Id + 1, std::memory_order_release);
+
+	return Id;
+}
+
+int32 FCtcAnalyticsNameTable::RejectName(FStringView Name)
+{
+	if (!bFullWarningLogged.exchange(true, std::memory_order_relaxed))
+	{
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Too many distinct names, %.*s and the names after it are copied with every event instead of being interned."), Name.Len(), Name.GetData());
+	}
+	return INDEX_NONE;
+}
+
+const FString& FCtcAnalyticsNameTable::GetName(int32 Id) const
+{
+	return GetEntry(Id).Name;
+}
+
+TConstArrayView<uint8> FCtcAnalyticsNameTable::GetEscapedName(int32 Id) const
+{
+	return GetEntry(Id).EscapedName;
+}
+
+int32 FCtcAnalyticsNameTable::GetFoldedId(int32 Id) const
+{
+	return GetEntry(Id).FoldedId;
+}
+
+const FCtcAnalyticsNameTable::FEntry& FCtcAnalyticsNameTable::GetEntry(int32 Id) const
+{
+	checkSlow(Id >= 0 && Id < NumEntries.load(std::memory_order_acquire));
+	return Blocks[Id / BlockSize][Id % BlockSize];
+}
@@ -0,0 +1,311 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsOutbox.h"
+
+#include <GenericPlatform/GenericPlatformFile.h>
+#include <HAL/FileManager.h>
+#include <HAL/PlatformFileManager.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+
+#include "CtcAnalyticsLog.h"
+
+namespace
+{
+	const TCHAR* SegmentExtension = TEXT(".segment");
+	const TCHAR* PartialSegmentExtension = TEXT(".partial");
+	const TCHAR* CrashSegmentExtension = TEXT(".crash");
+	constexpr int32 SegmentHeaderSize = sizeof(uint32) + sizeof(uint8);
+} // namespace
+
+FCtcAnalyticsOutbox::FCtcAnalyticsOutbox(const FString& InDirectory) : Directory(InDirectory)
+{
+	RunPrefix = FDateTime::UtcNow().ToString(TEXT("%Y%m%d%H%M%S_")) + FGuid::NewGuid().ToString(EGuidFormats::Short);
+
+	// NOTE: Created once, segments are written from worker threads for every batch
+	FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*Directory);
+}
+
+FCtcAnalyticsOutbox::~FCtcAnalyticsOutbox()
+{
+	DiscardCrashSegment();
+}
+
+FString FCtcAnalyticsOutbox::Store(TConstArrayView<uint8> Body, ECtcAnalyticsCompression ContentEncoding)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsOutbox::Store);
+
+	{
+		FScopeLock ScopeLock(&SegmentsLock);
+		ListSegments();
+	}
+
+	const uint32 SegmentIndex = NextSegmentIndex.fetch_add(1, std::memory_order_relaxed);
+	const FString SegmentPath = Directory / FString::Printf(TEXT("%s_%06u%s"), *RunPrefix, SegmentIndex, SegmentExtension);
+	const FString PartialPath = SegmentPath + PartialSegmentExtension;
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	// NOTE: Segments are written under a temporary name and renamed when complete, a crash mid-write never leaves a truncated segment behind
+	{
+		TUniquePtr<IFileHandle> FileHandle(PlatformFile.OpenWrite(*PartialPath));
+		if (!FileHandle)
+		{
+			UE_LOG(LogCtcAnalytics, Error, TEXT("Failed to create outbox segment %s."), *PartialPath);
+			return {};
+		}
+
+		uint8 Header[SegmentHeaderSize];
+		FMemory::Memcpy(Header, &SegmentMagic, sizeof(uint32));
+		Header[sizeof(uint32)] = static_cast<uint8>(ContentEncoding);
+
+		if (!FileHandle->Write(Header, SegmentHeaderSize) || !FileHandle->Write(Body.GetData(), Body.Num()))
+		{
+			UE_LOG(LogCtcAnalytics, Error, TEXT("Failed to write outbox segment %s."), *PartialPath);
+			FileHandle.Reset();
+			PlatformFile.DeleteFile(*PartialPath);
+			return {};
+		}
+	}
+
+	if (!PlatformFile.MoveFile(*SegmentPath, *PartialPath))
+	{
+		PlatformFile.DeleteFile(*PartialPath);
+		return {};
+	}
+
+	FScopeLock ScopeLock(&SegmentsLock);
+	Segments.Add({SegmentPath, SegmentHeaderSize + Body.Num()});
+	SegmentsSize += SegmentHeaderSize + Body.Num();
+	EvictOldestSegments();
+
+	return SegmentPath;
+}
+
+void FCtcAnalyticsOutbox::Remove(const FString& SegmentPath)
+{
+	if (SegmentPath.IsEmpty())
+	{
+		return;
+	}
+
+	FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*SegmentPath);
+
+	FScopeLock ScopeLock(&SegmentsLock);
+	const int32 Index = Segments.IndexOfByPredicate(
+		[&SegmentPath](const FSegment& Segment)
+		{
+			return Segment.Path == SegmentPath;
+		}
+	);
+	if (Index != INDEX_NONE)
+	{
+		SegmentsSize -= Segments[Index].Size;
+		Segments.RemoveAt(Index, 1, EAllowShrinking::No);
+	}
+}
+
+void FCtcAnalyticsOutbox::SetLimits(int64 InMaxSize, double InMaxSegmentAge)
+{
+	MaxSize.store(InMaxSize, std::memory_order_relaxed);
+	MaxSegmentAge.store(InMaxSegmentAge, std::memory_order_relaxed);
+}
+
+TArray<FString> FCtcAnalyticsOutbox::TakeRecoveredSegments()
+{
+	TArray<FString> RecoveredSegments;
+	if (bRecoveredSegmentsTaken.exchange(true))
+	{
+		return RecoveredSegments;
+	}
+
+	FScopeLock ScopeLock(&SegmentsLock);
+	ListSegments();
+	for (const FSegment& Segment : Segments)
+	{
+		if (!FPaths::GetCleanFilename(Segment.Path).StartsWith(RunPrefix))
+		{
+			RecoveredSegments.Add(Segment.Path);
+		}
+	}
+
+	return RecoveredSegments;
+}
+
+void FCtcAnalyticsOutbox::ListSegments()
+{
+	if (bSegmentsListed)
+	{
+		return;
+	}
+	bSegmentsListed = true;
+
+	TArray<FString> SegmentNames;
+	IFileManager::Get().FindFiles(SegmentNames, *(Directory / TEXT("*") + SegmentExtension), true, false);
+
+	// Crash segments share the format of the regular ones. Empty ones come from runs which were killed without crashing
+	TArray<FString> CrashSegmentNames;
+	IFileManager::Get().FindFiles(CrashSegmentNames, *(Directory / TEXT("*") + CrashSegmentExtension), true, false);
+	for (const FString& CrashSegmentName : CrashSegmentNames)
+	{
+		if (IFileManager::Get().FileSize(*(Directory / CrashSegmentName)) > SegmentHeaderSize)
+		{
+			SegmentNames.Add(CrashSegmentName);
+		}
+		else if (!CrashSegmentName.StartsWith(RunPrefix))
+		{
+			IFileManager::Get().Delete(*(Directory / CrashSegmentName), false, false, true);
+		}
+	}
+
+	// Names start with the run's timestamp so sorting them keeps the original order of the batches
+	SegmentNames.Sort();
+
+	// NOTE: Offline players would otherwise pile up segments forever, each launch uploading batches nobody needs anymore
+	const double MaxAge = MaxSegmentAge.load(std::memory_order_relaxed);
+	const FDateTime Now = FDateTime::UtcNow();
+	int32 NumExpired = 0;
+	for (const FString& SegmentName : SegmentNames)
+	{
+		const FString SegmentPath = Directory / SegmentName;
+		const FFileStatData StatData = IFileManager::Get().GetStatData(*SegmentPath);
+		if (!StatData.bIsValid)
+		{
+			continue;
+		}
+
+		if (MaxAge > 0.0 && !SegmentName.StartsWith(RunPrefix) && (Now - StatData.ModificationTime).GetTotalSeconds() > MaxAge)
+		{
+			IFileManager::Get().Delete(*SegmentPath, false, false, true);
+			++NumExpired;
+			continue;
+		}
+
+		Segments.Add({SegmentPath, StatData.FileSize});
+		SegmentsSize += StatData.FileSize;
+	}
+
+	if (NumExpired > 0)
+	{
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Deleted %d outbox segments older than %.0f hours, their events are lost."), NumExpired, MaxAge / 3600.0);
+	}
+
+	// Leftovers of segments which were being written when the application died
+	TArray<FString> PartialNames;
+	IFileManager::Get().FindFiles(PartialNames, *(Directory / TEXT("*") + PartialSegmentExtension), true, false);
+	for (const FString& PartialName : PartialNames)
+	{
+		if (!PartialName.StartsWith(RunPrefix))
+		{
+			IFileManager::Get().Delete(*(Directory / PartialName), false, false, true);
+		}
+	}
+
+	EvictOldestSegments();
+}
+
+void FCtcAnalyticsOutbox::EvictOldestSegments()
+{
+	const int64 Limit = MaxSize.load(std::memory_order_relaxed);
+
+	// NOTE: The newest segment is always kept, even when it's bigger than the whole budget on its own. A request still using an
+	// evicted segment sends its body from memory, or gets discarded as unreadable if it wasn't loaded yet
+	int32 NumEvicted = 0;
+	while (SegmentsSize > Limit && Segments.Num() > 1)
+	{
+		IFileManager::Get().Delete(*Segments[0].Path, false, false, true);
+		SegmentsSize -= Segments[0].Size;
+		Segments.RemoveAt(0, 1, EAllowShrinking::No);
+		++NumEvicted;
+	}
+
+	if (NumEvicted > 0)
+	{
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Outbox is over its budget of %lld bytes, deleted its %d oldest segments. Their events are lost."), Limit, NumEvicted);
+	}
+}
+
+bool FCtcAnalyticsOutbox::Load(const FString& SegmentPath, TArray<uint8>& OutBody, ECtcAnalyticsCompression& OutContentEncoding)
+{
+	TArray<uint8> Segment;
+	if (!FFileHelper::LoadFileToArray(Segment, *SegmentPath, FILEREAD_Silent) || Segment.Num() < SegmentHeaderSize)
+	{
+		return false;
+	}
+
+	uint32 Magic = 0;
+	FMemory::Memcpy(&Magic, Segment.GetData(), sizeof(uint32));
+	const uint8 ContentEncoding = Segment[sizeof(uint32)];
+	if (Magic != SegmentMagic || ContentEncoding > static_cast<uint8>(ECtcAnalyticsCompression::Zstd))
+	{
+		return false;
+	}
+
+	OutContentEncoding = static_cast<ECtcAnalyticsCompression>(ContentEncoding);
+	OutBody.Reset(Segment.Num() - SegmentHeaderSize);
+	OutBody.Append(Segment.GetData() + SegmentHeaderSize, Segment.Num() - SegmentHeaderSize);
+	return true;
+}
+
+void FCtcAnalyticsOutbox::PrepareCrashSegment(int32 Capacity)
+{
+	if (CrashSegmentHandle || Capacity <= 0)
+	{
+		return;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	// NOTE: Every preparation gets its own segment, a committed one from an earlier session of this run must not be overwritten
+	const uint32 SegmentIndex = NextSegmentIndex.fetch_add(1, std::memory_order_relaxed);
+	CrashSegmentPath = Directory / FString::Printf(TEXT("%s_%06u_crash%s"), *RunPrefix, SegmentIndex, CrashSegmentExtension);
+	bCrashSegmentCommitted = false;
+	CrashSegmentHandle.Reset(PlatformFile.OpenWrite(*CrashSegmentPath));
+	if (!CrashSegmentHandle)
+	{
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Failed to create crash segment %s, events pending when crashing will be lost."), *CrashSegmentPath);
+		return;
+	}
+
+	CrashBuffer.Reserve(Capacity);
+}
+
+TArray<uint8>* FCtcAnalyticsOutbox::GetCrashBuffer()
+{
+	return CrashSegmentHandle ? &CrashBuffer : nullptr;
+}
+
+bool FCtcAnalyticsOutbox::CommitCrashSegment()
+{
+	if (!CrashSegmentHandle || CrashBuffer.IsEmpty())
+	{
+		return false;
+	}
+
+	uint8 Header[SegmentHeaderSize];
+	FMemory::Memcpy(Header, &SegmentMagic, sizeof(uint32));
+	Header[sizeof(uint32)] = static_cast<uint8>(ECtcAnalyticsCompression::None);
+
+	// NOTE: The file is already open so there is no rename like Store does. An interrupted write leaves a truncated body
+	// behind, which the backend rejects on the next launch
+	const bool bWritten = CrashSegmentHandle->Seek(0) && CrashSegmentHandle->Write(Header, SegmentHeaderSize) && CrashSegmentHandle->Write(CrashBuffer.GetData(), CrashBuffer.Num()) && CrashSegmentHandle->Truncate(SegmentHeaderSize + CrashBuffer.Num());
+	CrashSegmentHandle->Flush(true);
+	bCrashSegmentCommitted |= bWritten;
+	return bWritten;
+}
+
+void FCtcAnalyticsOutbox::DiscardCrashSegment()
+{
+	if (!CrashSegmentHandle)
+	{
+		return;
+	}
+
+	// NOTE: A committed segment holds events which were taken out of the cache, it's uploaded by the next launch like after a crash
+	CrashSegmentHandle.Reset();
+	if (!bCrashSegmentCommitted)
+	{
+		FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*CrashSegmentPath);
+	}
+	CrashBuffer.Empty();
+}
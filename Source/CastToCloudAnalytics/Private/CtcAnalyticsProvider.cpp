@@ -3,27 +3,34 @@
 #include "CtcAnalyticsProvider.h"
 
 #include <Analytics.h>
-#include <Dom/JsonObject.h>
+#include <Async/ParallelFor.h>
 #include <Engine/Engine.h>
 #include <Engine/World.h>
 #include <GeneralProjectSettings.h>
 #include <GenericPlatform/GenericPlatformDriver.h>
-#include <HttpModule.h>
-#include <Interfaces/IHttpResponse.h>
 #include <Interfaces/IPluginManager.h>
 #include <Kismet/GameplayStatics.h>
 #include <Misc/App.h>
 #include <Misc/CommandLine.h>
-#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+#include <Misc/StringBuilder.h>
 #include <Runtime/Launch/Resources/Version.h>
-#include <Serialization/JsonSerializer.h>
+#include <Serialization/MemoryReader.h>
+#include <Serialization/MemoryWriter.h>
+#include <Tasks/Task.h>
 #include <UObject/Package.h>
+#include <UObject/UObjectGlobals.h>
 
 #if WITH_EDITOR
 #include <Editor.h>
 #endif
 
+#include "CtcAnalyticsCompression.h"
+#include "CtcAnalyticsFileSink.h"
+#include "CtcAnalyticsJsonEncoder.h"
 #include "CtcAnalyticsLog.h"
+#include "CtcAnalyticsOutbox.h"
+#include "CtcAnalyticsSendScheduler.h"
 #include "CtcSharedSettings.h"
 
 // clang-format off
@@ -36,6 +43,11 @@ TAutoConsoleVariable CVarCtcAnalyticsPrintDebugFlags(
 
 namespace
 {
+	/**
+	 * Key of the first on screen message of the debug display, the following lines use the next keys
+	 */
+	constexpr uint64 DebugDisplayFirstKey = 0x4374634100000000;
+
 	FString GetPlatformAttribution()
 	{
 		FString PotentialValue;
@@ -55,49 +67,51 @@ namespace
 		return {};
 	}
 
-	void SaveEventsToFile(const FString& SessionId, const TArray<TSharedPtr<FJsonValue>>& Events)
+	/**
+	 * Turns a serialized JSON array of events into newline delimited JSON, one event per line
+	 */
+	TArray<uint8> ConvertToNewlineDelimited(TArray<uint8>&& EventsArray, TConstArrayView<TPair<int32, int32>> EventSpans)
 	{
-		const FString TargetFile = FPaths::ProjectSavedDir() / TEXT("CastToCloud") / TEXT("Analytics") / SessionId + TEXT(".json");
-		TArray<TSharedPtr<FJsonValue>> AllEvents;
-
-		FString PreviousEventsJSON;
-		if (FFileHelper::LoadFileToString(PreviousEventsJSON, *TargetFile))
+		// The commas between events and the closing bracket become line breaks, only the opening bracket needs to go
+		for (int32 Index = 1; Index < EventSpans.Num(); ++Index)
 		{
-			TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(PreviousEventsJSON);
-			FJsonSerializer::Deserialize(Reader, AllEvents);
+			EventsArray[EventSpans[Index].Key - 1] = '\n';
 		}
+		EventsArray.Last() = '\n';
+		EventsArray.RemoveAt(0, 1, EAllowShrinking::No);
 
-		AllEvents.Append(Events);
-
-		FString OutputString;
-		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&OutputString);
-		FJsonSerializer::Serialize(AllEvents, Writer);
-
-		FFileHelper::SaveStringToFile(OutputString, *TargetFile);
+		return MoveTemp(EventsArray);
 	}
 
-	void PrintEventsToLog(const FString& SessionId, const TArray<TSharedPtr<FJsonValue>>& Events)
+	void PrintEventsToLog(const FString& SessionId, TConstArrayView<uint8> Events, TConstArrayView<TPair<int32, int32>> EventSpans)
 	{
-		UE_LOG(LogCtcAnalytics, Display, TEXT("Printing %s cached events for session %s:"), *LexToString(Events.Num()), *SessionId);
-		for (const TSharedPtr<FJsonValue>& Event : Events)
+		UE_LOG(LogCtcAnalytics, Display, TEXT("Printing %s cached events for session %s:"), *LexToString(EventSpans.Num()), *SessionId);
+		for (const TPair<int32, int32>& EventSpan : EventSpans)
 		{
-			FString EventString;
-			TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&EventString);
-			FJsonSerializer::Serialize(Event->AsObject().ToSharedRef(), Writer);
+			const FUTF8ToTCHAR EventChars(reinterpret_cast<const ANSICHAR*>(Events.GetData() + EventSpan.Key), EventSpan.Value);
+			const FString EventString(EventChars.Length(), EventChars.Get());
 
 			UE_LOG(LogCtcAnalytics, Display, TEXT("    %s"), *EventString)
 		}
 	}
 } // namespace
 
-FCtcAnalyticsProvider::FCtcAnalyticsProvider()
+FCtcAnalyticsNameTable FCtcAnalyticsProvider::SharedEventNames;
+FCtcAnalyticsNameTable FCtcAnalyticsProvider::SharedAttributeKeys;
+std::atomic<FCtcAnalyticsProvider*> FCtcAnalyticsProvider::Instance = nullptr;
+
+FCtcAnalyticsProvider::FCtcAnalyticsProvider() : FCtcAnalyticsProvider(FPaths::ProjectSavedDir() / TEXT("CastToCloud") / TEXT("Analytics"), false)
 {
 	// TODO: Move everything to the auto tracker subsystem and make it an engine subsystem.
-	FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FCtcAnalyticsProvider::Tick), 0.0f);
+	Instance.store(this, std::memory_order_release);
+
+	ScheduleFlush(0.0);
+	DebugDisplayTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FCtcAnalyticsProvider::TickDebugDisplay), DebugDisplayInterval);
 
 #if WITH_EDITOR
 	FEditorDelegates::StartPIE.AddRaw(this, &FCtcAnalyticsProvider::OnPIEStarted);
 	FEditorDelegates::ShutdownPIE.AddRaw(this, &FCtcAnalyticsProvider::OnPIEEnded);
+	GetMutableDefault<UCtcSharedSettings>()->OnSettingChanged().AddRaw(this, &FCtcAnalyticsProvider::OnSettingsChanged);
 #else
 	FCoreDelegates::OnPostEngineInit.AddRaw(this, &FCtcAnalyticsProvider::OnPostEngineInit);
 	FCoreDelegates::OnEnginePreExit.AddRaw(this, &FCtcAnalyticsProvider::OnEnginePreExit);
@@ -117,16 +131,62 @@ FCtcAnalyticsProvider::FCtcAnalyticsProvider()
 	FWorldDelegates::OnWorldBeginTearDown.AddRaw(this, &FCtcAnalyticsProvider::OnWorldEndPlay);
 }
 
-void FCtcAnalyticsProvider::RecordEventWithTransform(const FString& EventName, const FTransform& Transform, const TArray<FAnalyticsEventAttribute>& Attributes)
+FCtcAnalyticsProvider::FCtcAnalyticsProvider(const FString& StorageDir) : FCtcAnalyticsProvider(StorageDir, true)
+{
+}
+
+FCtcAnalyticsProvider::FCtcAnalyticsProvider(const FString& StorageDir, bool bOwnNameTables)
+	: SpillFile(StorageDir / TEXT("Spill"))
+	, OwnedEventNames(bOwnNameTables ? MakeUnique<FCtcAnalyticsNameTable>() : nullptr)
+	, OwnedAttributeKeys(bOwnNameTables ? MakeUnique<FCtcAnalyticsNameTable>() : nullptr)
+	, EventNames(OwnedEventNames ? *OwnedEventNames : SharedEventNames)
+	, AttributeKeys(OwnedAttributeKeys ? *OwnedAttributeKeys : SharedAttributeKeys)
+	, FileSink(StorageDir)
+	, Outbox(StorageDir / TEXT("Outbox"))
+{
+	ActiveEventArena = EventArenas.Add_GetRef(MakeUnique<FCtcAnalyticsEventArena>()).Get();
+	RefreshSendPolicy();
+}
+
+FCtcAnalyticsProvider::~FCtcAnalyticsProvider()
+{
+	FCtcAnalyticsProvider* Self = this;
+	Instance.compare_exchange_strong(Self, nullptr);
+
+#if WITH_EDITOR
+	if (UObjectInitialized())
+	{
+		GetMutableDefault<UCtcSharedSettings>()->OnSettingChanged().RemoveAll(this);
+	}
+#endif
+
+	FTSTicker::RemoveTicker(DebugDisplayTickerHandle);
+	{
+		FScopeLock ScopeLock(&FlushTimerLock);
+		FTSTicker::RemoveTicker(FlushTimerHandle);
+		FTSTicker::RemoveTicker(CriticalFlushTimerHandle);
+	}
+
+	// Flush tasks capture this provider, make sure none of them outlive it
+	FlushPipe.WaitUntilEmpty();
+	UE::Tasks::Wait(InFlightFlushes);
+}
+
+void FCtcAnalyticsProvider::RecordEventWithTransform(FStringView EventName, const FTransform& Transform, TConstArrayView<FAnalyticsEventAttribute> Attributes)
 {
-	TOptional<FTransform> InputTransform = Transform;
-	RecordEventInternal(EventName, InputTransform, Attributes);
+	RecordEventInternal(EventName, &Transform, Attributes);
 }
 
 bool FCtcAnalyticsProvider::StartSession(const TArray<FAnalyticsEventAttribute>& Attributes)
 {
 	if (State == ESessionState::None)
 	{
+		// NOTE: The session is needed upfront so its events are sampled the same way from the very first one
+		if (!SessionID.IsSet())
+		{
+			SetSessionID(FGuid::NewGuid().ToString());
+		}
+
 		State = ESessionState::Started;
 		RecordEvent(TEXT("SessionStart"), Attributes);
 	}
@@ -159,6 +219,8 @@ FString FCtcAnalyticsProvider::GetSessionID() const
 bool FCtcAnalyticsProvider::SetSessionID(const FString& InSessionID)
 {
 	SessionID = InSessionID;
+	BatchContext.Reset();
+	RefreshEventFilter();
 	return true;
 }
 
@@ -170,6 +232,7 @@ void FCtcAnalyticsProvider::FlushEvents()
 void FCtcAnalyticsProvider::SetUserID(const FString& InUserID)
 {
 	UserID = InUserID;
+	BatchContext.Reset();
 }
 
 FString FCtcAnalyticsProvider::GetUserID() const
@@ -180,6 +243,7 @@ FString FCtcAnalyticsProvider::GetUserID() const
 void FCtcAnalyticsProvider::SetDefaultEventAttributes(TArray<FAnalyticsEventAttribute>&& Attributes)
 {
 	DefaultAttributes = Attributes;
+	BatchContext.Reset();
 }
 
 TArray<FAnalyticsEventAttribute> FCtcAnalyticsProvider::GetDefaultEventAttributesSafe() const
@@ -199,8 +263,12 @@ FAnalyticsEventAttribute FCtcAnalyticsProvider::GetDefaultEventAttribute(int Att
 
 void FCtcAnalyticsProvider::RecordEvent(const FString& EventName, const TArray<FAnalyticsEventAttribute>& Attributes)
 {
-	TOptional<FTransform> NoTransform;
-	RecordEventInternal(EventName, NoTransform, Attributes);
+	RecordEventInternal(EventName, nullptr, Attributes);
+}
+
+void FCtcAnalyticsProvider::RecordEvent(FStringView EventName, TConstArrayView<FAnalyticsEventAttribute> Attributes)
+{
+	RecordEventInternal(EventName, nullptr, Attributes);
 }
 
 void FCtcAnalyticsProvider::RefreshBuiltInAttributes()
@@ -223,347 +291,1726 @@ void FCtcAnalyticsProvider::RefreshBuiltInAttributes()
 	BuildInUserAttributes.Emplace(TEXT("gpu.device"), GpuDriverInfo.DeviceDescription);
 	BuildInUserAttributes.Emplace(TEXT("gpu.provider"), GpuDriverInfo.ProviderName);
 	BuildInUserAttributes.Emplace(TEXT("gpu.version"), GpuDriverInfo.UserDriverVersion);
+
+	// NOTE: Neither the send policy nor the active provider change during a session, they're resolved again once for the next one instead of for every event or batch
+	RefreshSendPolicy();
+	ResolveAcceptState();
+
+	BatchContext.Reset();
+	RefreshEventFilter();
+	RefreshCacheLimits();
 }
 
-void FCtcAnalyticsProvider::RecordEventInternal(const FString& EventName, TOptional<FTransform>& Transform, const TArray<FAnalyticsEventAttribute>& Attributes)
+void FCtcAnalyticsProvider::RefreshSendPolicy()
+{
+	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+
+	FSendPolicy NewPolicy;
+	NewPolicy.EventsUrl = Settings->ApiUrl / TEXT("events/record");
+	NewPolicy.ApiKey = Settings->RuntimeApiKey;
+
+	if (FParse::Param(FCommandLine::Get(), TEXT("AnalyticsToFile")))
+	{
+		NewPolicy.Destination = EBatchDestination::File;
+	}
+	else if (FParse::Param(FCommandLine::Get(), TEXT("AnalyticsToLog")))
+	{
+		NewPolicy.Destination = EBatchDestination::Log;
+	}
+	else if (!FParse::Param(FCommandLine::Get(), TEXT("AnalyticsAnyConfiguration")) && !Settings->AllowedExecutables.IsCurrentConfigurationAllowed())
+	{
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Events won't be recorded because current configuration is not allowed."));
+		NewPolicy.Destination = EBatchDestination::Discard;
+	}
+
+	SendPolicy = MoveTemp(NewPolicy);
+	bIsSendingAllowed = SendPolicy.Destination != EBatchDestination::Discard;
+	BatchContext.Reset();
+}
+
+void FCtcAnalyticsProvider::RecordEventInternal(FStringView EventName, const FTransform* Transform, TConstArrayView<FAnalyticsEventAttribute> Attributes)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::RecordEventInternal);
 
-	if (!IsActiveProvider())
+	int32 NameId;
+	bool bCritical;
+	if (!AcceptEvent(EventName, NameId, bCritical))
 	{
-		UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Event %s was skipped because CastToCloud is not the current provider."), *EventName);
 		return;
 	}
 
-	if (State == ESessionState::None)
+	// The attributes are described on the stack pointing to the caller's data, CacheEvent copies them only once. Keys are
+	// interned, only the values are copied
+	TArray<FCachedAttribute, TInlineAllocator<16>> SourceAttributes;
+	SourceAttributes.Reserve(Attributes.Num());
+	for (const FAnalyticsEventAttribute& Attribute : Attributes)
 	{
-		UE_LOG(LogCtcAnalytics, Warning, TEXT("Event %s was recorded before session start."), *EventName);
+		const int32 KeyId = AttributeKeys.Intern(Attribute.GetName());
+		SourceAttributes.Add(Attribute.IsJsonFragment() ? FCachedAttribute::MakeJsonFragment(KeyId, Attribute.GetName(), Attribute.GetValue()) : FCachedAttribute::MakeString(KeyId, Attribute.GetName(), Attribute.GetValue()));
 	}
-	else if (State == ESessionState::Ended)
+
+	CacheEvent(EventName, NameId, Transform, SourceAttributes, bCritical);
+}
+
+bool FCtcAnalyticsProvider::AcceptEvent(FStringView EventName, int32& OutNameId, bool& bOutCritical)
+{
+	if (!IsAcceptingEvents())
 	{
-		UE_LOG(LogCtcAnalytics, Warning, TEXT("Event %s was recorded after session end."), *EventName);
+		UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Event %.*s was skipped because CastToCloud is not the current provider or the configuration is not allowed."), EventName.Len(), EventName.GetData());
+		return false;
 	}
 
-	FCachedEvent Event;
-	Event.Name = EventName;
-	Event.Transform = Transform;
-	Event.Timestamp = FDateTime::UtcNow();
-	Event.Attributes = Attributes;
-
-	if (GWorld && GWorld->GetPackage())
+	if (!FilterEvent(EventName, bOutCritical))
 	{
-		Event.World = UWorld::StripPIEPrefixFromPackageName(GWorld->GetPackage()->GetName(), GWorld->StreamingLevelsPrefix);
+		return false;
 	}
 
-	CachedEvents.Add(Event);
+	// NOTE: Only events which are kept are interned, names of sampled out or dropped events never take room in the table
+	OutNameId = EventNames.Intern(EventName);
+	return true;
 }
 
-bool FCtcAnalyticsProvider::Tick(float DeltaTime)
+bool FCtcAnalyticsProvider::FilterEvent(FStringView EventName, bool& bOutCritical)
 {
-	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
-
-	const FDateTime Now = FDateTime::UtcNow();
-	const FTimespan TimeSinceLast = Now - LastTickSend;
-	if (TimeSinceLast.GetTotalSeconds() > Settings->SendInterval)
+	// NOTE: Critical events are few and far between, they skip the sampling and every limit protecting the bulk lane
+	bOutCritical = EventFilter.IsCritical(EventName);
+	if (bOutCritical)
 	{
-		SendCachedEvents();
+		return true;
 	}
 
-	if (CVarCtcAnalyticsPrintDebugFlags.GetValueOnAnyThread())
+	switch (EventFilter.Check(EventName))
 	{
-		TArray<FString> DebugFlags;
-		DebugFlags.Add(FString::Printf(TEXT("SessionId: %s"), *GetSessionID()));
-		DebugFlags.Add(FString::Printf(TEXT("UserId: %s"), *GetUserID()));
-		DebugFlags.Add(FString::Printf(TEXT("Events in cache: %s"), *LexToString(CachedEvents.Num())));
-		DebugFlags.Add(FString::Printf(TEXT("Next flush in: %.2f"), Settings->SendInterval - TimeSinceLast.GetTotalSeconds()));
+	case FCtcAnalyticsEventFilter::EResult::SampledOut:
+		UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Event %.*s was skipped because this session is sampled out."), EventName.Len(), EventName.GetData());
+		return false;
+	case FCtcAnalyticsEventFilter::EResult::RateLimited:
+		UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Event %.*s was dropped because it exceeded its rate limit."), EventName.Len(), EventName.GetData());
+		NumRateLimitedEvents.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	default:
+		break;
+	}
 
-		GEngine->AddOnScreenDebugMessage(-1, 0.0f, FColor::Black, TEXT("Cast To Cloud Analytics"), false);
-		for (const FString& DebugFlag : DebugFlags)
-		{
-			GEngine->AddOnScreenDebugMessage(-1, 0.0f, FColor::Black, *DebugFlag, false);
-		}
+	if (SendScheduler.IsBackpressured())
+	{
+		UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Event %.*s was dropped because too much data is waiting to be sent."), EventName.Len(), EventName.GetData());
+		NumDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+		return false;
 	}
 
 	return true;
 }
 
-void FCtcAnalyticsProvider::SendCachedEvents(bool bWait)
+void FCtcAnalyticsProvider::CacheEvent(FStringView EventName, int32 NameId, const FTransform* Transform, TConstArrayView<FCachedAttribute> Attributes, bool bCritical)
 {
-	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::SendCachedEvents);
-
-	const FDateTime Now = FDateTime::UtcNow();
-	LastTickSend = Now;
-
-	if (CachedEvents.IsEmpty())
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::CacheEvent);
+
+	// The event is described on the stack pointing to the caller's data, and copied only once to wherever it's kept
+	FCachedEvent Source;
+	Source.NameId = NameId;
+	Source.Name = NameId == INDEX_NONE ? EventName : FStringView();
+	Source.Cycles = FPlatformTime::Cycles64();
+	Source.WorldId = CurrentWorldId.load(std::memory_order_relaxed);
+	Source.Transform = Transform;
+	Source.Attributes = Attributes;
+
+	// NOTE: The overflow policy runs before anything is copied, rejected events cost next to nothing
+	bool bSpill = false;
+	if (!bCritical && !AdmitEvent(EventName, NameId, GetEventMemorySize(Source), bSpill))
 	{
 		return;
 	}
 
-	if (!UserID.IsSet())
+	if (State == ESessionState::None)
 	{
-		const FString UniqueUserId = FGenericPlatformMisc::GetLoginId();
-		SetUserID(UniqueUserId);
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Event %.*s was recorded before session start."), EventName.Len(), EventName.GetData());
 	}
-
-	if (!SessionID.IsSet())
+	else if (State == ESessionState::Ended)
 	{
-		SetSessionID(FGuid::NewGuid().ToString());
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Event %.*s was recorded after session end."), EventName.Len(), EventName.GetData());
 	}
 
-	UE_LOG(LogCtcAnalytics, Verbose, TEXT("Sending %s cached events"), *LexToString(CachedEvents.Num()));
-	TArray<TSharedPtr<FJsonValue>> EventsArray;
-	for (const FCachedEvent& Event : CachedEvents)
+	if (bCritical)
 	{
-		TSharedRef<FJsonObject> EventObject = MakeShared<FJsonObject>();
-		EventObject->SetStringField(TEXT("event_name"), Event.Name);
-		EventObject->SetStringField(TEXT("created_at"), Event.Timestamp.ToIso8601());
-		EventObject->SetStringField(TEXT("session_id"), GetSessionID());
-		EventObject->SetStringField(TEXT("user_id"), GetUserID());
+		CriticalEvents.Enqueue(CopyToArena(Source));
 
-		// Merge the event's properties with the default attributes. Event attributes are appended last so they can override
-		TSharedPtr<FJsonObject> EventProperties = MakeShared<FJsonObject>();
-		for (const TTuple<FString, FString>& Attribute : BuiltInEventAttributes)
+		// The context of the batches can only be built on the game thread, events from other threads go out on the next frame
+		if (IsInGameThread())
 		{
-			EventProperties->SetField(Attribute.Key, MakeShared<FJsonValueString>(Attribute.Value));
+			SendCriticalEvents();
 		}
-		for (const FAnalyticsEventAttribute& Attribute : DefaultAttributes)
-		{
-			EventProperties->SetField(Attribute.GetName(), MakeShared<FJsonValueString>(Attribute.GetValue()));
-		}
-		for (const FAnalyticsEventAttribute& Attribute : Event.Attributes)
+		else if (!bCriticalFlushRequested.exchange(true, std::memory_order_relaxed))
 		{
-			EventProperties->SetField(Attribute.GetName(), MakeShared<FJsonValueString>(Attribute.GetValue()));
+			FScopeLock ScopeLock(&FlushTimerLock);
+			CriticalFlushTimerHandle = FTSTicker::GetCoreTicker().AddTicker(
+				FTickerDelegate::CreateLambda(
+					[this](float DeltaTime)
+					{
+						SendCriticalEvents();
+						return false;
+					}
+				),
+				0.0f
+			);
 		}
-		EventObject->SetObjectField(TEXT("event_properties"), EventProperties);
+		return;
+	}
 
-		TSharedPtr<FJsonObject> UserProperties = MakeShared<FJsonObject>();
-		for (const TTuple<FString, FString>& Attribute : BuildInUserAttributes)
+	if (bSpill)
+	{
+		TArray<uint8> SpilledRecord;
+		FMemoryWriter Writer(SpilledRecord);
+		SaveSpilledEvent(Writer, Source);
+		if (!SpillFile.Append(SpilledRecord))
 		{
-			UserProperties->SetField(Attribute.Key, MakeShared<FJsonValueString>(Attribute.Value));
+			NumOverflowDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+			return;
 		}
-		EventObject->SetObjectField(TEXT("user_properties"), UserProperties);
 
-		EventObject->SetStringField(TEXT("world"), Event.World);
+		NumSpilledEvents.fetch_add(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		FCachedEvent* Event = CopyToArena(Source);
+		PendingEventsMemory.fetch_add(Event->MemorySize, std::memory_order_relaxed);
+		PendingEvents.Enqueue(Event);
+	}
+
+	// Bursts are flushed right away instead of waiting for the send interval. Only the first event crossing a threshold arms the timer
+	const int32 NumPending = NumPendingEvents.fetch_add(1, std::memory_order_relaxed) + 1;
+	const bool bOverThreshold = NumPending >= FlushEventThreshold.load(std::memory_order_relaxed) || PendingEventsMemory.load(std::memory_order_relaxed) >= FlushMemoryThreshold.load(std::memory_order_relaxed);
+	if (bOverThreshold && !bEarlyFlushRequested.exchange(true, std::memory_order_relaxed))
+	{
+		ScheduleFlush(0.0);
+	}
+}
 
-		if (Event.Transform.IsSet())
-		{
-			const FVector Position = Event.Transform->GetTranslation();
-			EventObject->SetNumberField(TEXT("position_x"), Position.X);
-			EventObject->SetNumberField(TEXT("position_y"), Position.Y);
-			EventObject->SetNumberField(TEXT("position_z"), Position.Z);
+FCtcAnalyticsProvider::FCachedAttribute FCtcAnalyticsProvider::FCachedAttribute::MakeString(int32 InKeyId, FStringView InKey, FStringView InValue)
+{
+	FCachedAttribute Attribute;
+	Attribute.KeyId = InKeyId;
+	Attribute.Key = InKeyId == INDEX_NONE ? InKey : FStringView();
+	Attribute.Value = InValue;
+	return Attribute;
+}
 
-			const FQuat Rotation = Event.Transform->GetRotation();
-			EventObject->SetNumberField(TEXT("rotation_x"), Rotation.X);
-			EventObject->SetNumberField(TEXT("rotation_y"), Rotation.Y);
-			EventObject->SetNumberField(TEXT("rotation_z"), Rotation.Z);
-			EventObject->SetNumberField(TEXT("rotation_w"), Rotation.W);
-		}
+FCtcAnalyticsProvider::FCachedAttribute FCtcAnalyticsProvider::FCachedAttribute::MakeInteger(int32 InKeyId, FStringView InKey, int64 InValue)
+{
+	FCachedAttribute Attribute;
+	Attribute.KeyId = InKeyId;
+	Attribute.Key = InKeyId == INDEX_NONE ? InKey : FStringView();
+	Attribute.Type = EType::Integer;
+	Attribute.IntegerValue = InValue;
+	return Attribute;
+}
+
+FCtcAnalyticsProvider::FCachedAttribute FCtcAnalyticsProvider::FCachedAttribute::MakeNumber(int32 InKeyId, FStringView InKey, double InValue)
+{
+	FCachedAttribute Attribute;
+	Attribute.KeyId = InKeyId;
+	Attribute.Key = InKeyId == INDEX_NONE ? InKey : FStringView();
+	Attribute.Type = EType::Number;
+	Attribute.NumberValue = InValue;
+	return Attribute;
+}
 
-		EventsArray.Add(MakeShared<FJsonValueObject>(EventObject));
+FCtcAnalyticsProvider::FCachedAttribute FCtcAnalyticsProvider::FCachedAttribute::MakeBool(int32 InKeyId, FStringView InKey, bool bInValue)
+{
+	FCachedAttribute Attribute;
+	Attribute.KeyId = InKeyId;
+	Attribute.Key = InKeyId == INDEX_NONE ? InKey : FStringView();
+	Attribute.Type = EType::Bool;
+	Attribute.IntegerValue = bInValue ? 1 : 0;
+	return Attribute;
+}
+
+FCtcAnalyticsProvider::FCachedAttribute FCtcAnalyticsProvider::FCachedAttribute::MakeJsonFragment(int32 InKeyId, FStringView InKey, FStringView InValue)
+{
+	FCachedAttribute Attribute;
+	Attribute.KeyId = InKeyId;
+	Attribute.Key = InKeyId == INDEX_NONE ? InKey : FStringView();
+	Attribute.Type = EType::JsonFragment;
+	Attribute.Value = InValue;
+	return Attribute;
+}
+
+int32 FCtcAnalyticsProvider::GetEventMemorySize(const FCachedEvent& Event)
+{
+	// NOTE: Same layout as CopyToArena. Names and keys are interned and shared by all the events, only the values and the
+	// names which didn't fit in their table are copied
+	int32 NumChars = Event.Name.Len();
+	for (const FCachedAttribute& Attribute : Event.Attributes)
+	{
+		NumChars += Attribute.Key.Len() + Attribute.Value.Len();
 	}
-	CachedEvents.Empty();
 
-	if (FParse::Param(FCommandLine::Get(), TEXT("AnalyticsToFile")))
+	const SIZE_T AttributesOffset = Align(Align(sizeof(FCachedEvent), alignof(FTransform)) + (Event.Transform ? sizeof(FTransform) : 0), alignof(FCachedAttribute));
+	const SIZE_T Size = AttributesOffset + Event.Attributes.Num() * sizeof(FCachedAttribute) + NumChars * sizeof(TCHAR);
+	return static_cast<int32>(FMath::Min<SIZE_T>(Size, MAX_int32));
+}
+
+FCtcAnalyticsProvider::FCachedEvent* FCtcAnalyticsProvider::CopyToArena(const FCachedEvent& Source)
+{
+	const int32 Size = GetEventMemorySize(Source);
+
+	FCtcAnalyticsEventArena& Arena = AcquireEventArena();
+	uint8* Memory = static_cast<uint8*>(Arena.Allocate(Size, FMath::Max(alignof(FCachedEvent), alignof(FTransform))));
+
+	FCachedEvent* Event = new (Memory) FCachedEvent();
+	Event->Arena = &Arena;
+	Event->NameId = Source.NameId;
+	Event->Cycles = Source.Cycles;
+	Event->WorldId = Source.WorldId;
+	Event->MemorySize = Size;
+
+	// The transform, the attributes and their characters follow the event
+	uint8* Cursor = Memory + Align(sizeof(FCachedEvent), alignof(FTransform));
+	if (Source.Transform)
 	{
-		SaveEventsToFile(GetSessionID(), EventsArray);
-		return;
+		Event->Transform = new (Cursor) FTransform(*Source.Transform);
+		Cursor += sizeof(FTransform);
 	}
 
-	if (FParse::Param(FCommandLine::Get(), TEXT("AnalyticsToLog")))
+	FCachedAttribute* Attributes = reinterpret_cast<FCachedAttribute*>(Align(Cursor, alignof(FCachedAttribute)));
+	TCHAR* Chars = reinterpret_cast<TCHAR*>(Attributes + Source.Attributes.Num());
+	auto CopyChars = [&Chars](FStringView String)
 	{
-		PrintEventsToLog(GetSessionID(), EventsArray);
-		return;
+		FMemory::Memcpy(Chars, String.GetData(), String.Len() * sizeof(TCHAR));
+		const FStringView Copy(Chars, String.Len());
+		Chars += String.Len();
+		return Copy;
+	};
+	Event->Name = CopyChars(Source.Name);
+	for (int32 Index = 0; Index < Source.Attributes.Num(); ++Index)
+	{
+		FCachedAttribute* Attribute = new (&Attributes[Index]) FCachedAttribute(Source.Attributes[Index]);
+		Attribute->Key = CopyChars(Attribute->Key);
+		Attribute->Value = CopyChars(Attribute->Value);
 	}
+	Event->Attributes = MakeArrayView(Attributes, Source.Attributes.Num());
 
-	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
-	const bool bAllowAnyConfiguration = FParse::Param(FCommandLine::Get(), TEXT("AnalyticsAnyConfiguration"));
-	if (Settings && !Settings->AllowedExecutables.IsCurrentConfigurationAllowed() && !bAllowAnyConfiguration)
+	return Event;
+}
+
+FCtcAnalyticsEventArena& FCtcAnalyticsProvider::AcquireEventArena()
+{
+	// NOTE: The reference is taken before making sure the arena is still the active one. Snapshots never reset a referenced
+	// arena, so once this succeeds the arena stays valid until the event is consumed
+	for (;;)
 	{
-		UE_LOG(LogCtcAnalytics, Warning, TEXT("Skipping %s events for session %s because current configuration is not allowed"), *LexToString(EventsArray.Num()), *GetSessionID());
-		return;
+		FCtcAnalyticsEventArena* Arena = ActiveEventArena.load();
+		Arena->AddReferences(1);
+		if (ActiveEventArena.load() == Arena)
+		{
+			return *Arena;
+		}
+		Arena->ReleaseReferences(1);
 	}
+}
 
-	TSharedRef<FJsonObject> RequestBody = MakeShared<FJsonObject>();
-	RequestBody->SetArrayField(TEXT("eventsPayload"), EventsArray);
-	RequestBody->SetBoolField(TEXT("geoTracking"), Settings->bEnableGeolocationAttribution);
+void FCtcAnalyticsProvider::RotateEventArenas()
+{
+	FCtcAnalyticsEventArena* RetiredArena = ActiveEventArena.load();
 
-	FString RequestBodyString;
-	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&RequestBodyString);
-	ensure(FJsonSerializer::Serialize(RequestBody, Writer));
+	// NOTE: Arenas are never deleted, a producer about to use a retired arena might still add a reference to it. Spare ones
+	// only give their memory back
+	FCtcAnalyticsEventArena* NextArena = nullptr;
+	for (const TUniquePtr<FCtcAnalyticsEventArena>& Arena : EventArenas)
+	{
+		if (Arena.Get() == RetiredArena || Arena->IsReferenced())
+		{
+			continue;
+		}
 
-	FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
-	Request->SetVerb(TEXT("POST"));
-	Request->SetURL(Settings->ApiUrl / TEXT("events/record"));
-	Request->SetHeader(TEXT("X-API-Key"), Settings->RuntimeApiKey);
-	Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-	Request->SetContentAsString(RequestBodyString);
+		if (NextArena)
+		{
+			Arena->Reset(true);
+		}
+		else
+		{
+			NextArena = Arena.Get();
+		}
+	}
 
-	if (bWait)
+	if (NextArena)
 	{
-		Request->ProcessRequestUntilComplete();
-		const bool bSuccess = Request->GetStatus() == EHttpRequestStatus::Succeeded;
-		OnEventResponse(Request, Request->GetResponse(), bSuccess);
+		NextArena->Reset();
 	}
 	else
 	{
-		Request->OnProcessRequestComplete().BindRaw(this, &FCtcAnalyticsProvider::OnEventResponse);
-		Request->ProcessRequest();
+		NextArena = EventArenas.Add_GetRef(MakeUnique<FCtcAnalyticsEventArena>()).Get();
 	}
+
+	ActiveEventArena.store(NextArena);
 }
 
-#if WITH_EDITOR
-void FCtcAnalyticsProvider::OnPIEStarted(bool bIsSimulating)
+void FCtcAnalyticsProvider::ReleaseEvents(TConstArrayView<FCachedEvent*> Events)
 {
-	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnPIEStarted called. Starting session."));
-
-	RefreshBuiltInAttributes();
-
-	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
-	if (Settings->bAutoStartSession && State == ESessionState::None)
+	// Consecutive events usually come from the same arena, their references are released a run at a time
+	int32 RunStart = 0;
+	for (int32 Index = 1; Index <= Events.Num(); ++Index)
 	{
-		StartSession({});
+		if (Index == Events.Num() || Events[Index]->Arena != Events[RunStart]->Arena)
+		{
+			Events[RunStart]->Arena->ReleaseReferences(Index - RunStart);
+			RunStart = Index;
+		}
 	}
 }
-#endif
 
-#if WITH_EDITOR
-void FCtcAnalyticsProvider::OnPIEEnded(bool bIsSimulating)
+FCtcAnalyticsProvider::FBatch::~FBatch()
 {
-	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnPIEEnded called. Ending session and sending cached events."));
+	ReleaseEvents(Events);
+}
 
-	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
-	if (Settings->bAutoStartSession && State == ESessionState::Started)
+void FCtcAnalyticsProvider::SaveSpilledEvent(FArchive& Ar, const FCachedEvent& Event)
+{
+	int32 NameId = Event.NameId;
+	uint64 Cycles = Event.Cycles;
+	int32 WorldId = Event.WorldId;
+	Ar << NameId;
+	if (NameId == INDEX_NONE)
 	{
-		EndSession();
+		FString Name(Event.Name);
+		Ar << Name;
 	}
+	Ar << Cycles;
+	Ar << WorldId;
 
-	SendCachedEvents(true);
+	bool bHasTransform = Event.Transform != nullptr;
+	Ar << bHasTransform;
+	if (bHasTransform)
+	{
+		FTransform Transform = *Event.Transform;
+		Ar << Transform;
+	}
 
-	Reset();
+	int32 NumAttributes = Event.Attributes.Num();
+	Ar << NumAttributes;
+	for (const FCachedAttribute& Attribute : Event.Attributes)
+	{
+		int32 KeyId = Attribute.KeyId;
+		uint8 Type = static_cast<uint8>(Attribute.Type);
+		Ar << KeyId;
+		if (KeyId == INDEX_NONE)
+		{
+			FString Key(Attribute.Key);
+			Ar << Key;
+		}
+		Ar << Type;
+		if (Attribute.Type == FCachedAttribute::EType::String || Attribute.Type == FCachedAttribute::EType::JsonFragment)
+		{
+			FString Value(Attribute.Value);
+			Ar << Value;
+		}
+		else
+		{
+			// NOTE: Numbers are saved through their bits, the union holds either of them
+			int64 Value = Attribute.IntegerValue;
+			Ar << Value;
+		}
+	}
 }
-#endif
 
-void FCtcAnalyticsProvider::OnPostEngineInit()
+FCtcAnalyticsProvider::FCachedEvent* FCtcAnalyticsProvider::LoadSpilledEvent(FArchive& Ar)
 {
-	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnPostEngineInit called. Starting session."));
+	FCachedEvent Source;
+	FString Name;
+	Ar << Source.NameId;
+	if (Source.NameId == INDEX_NONE)
+	{
+		Ar << Name;
+		Source.Name = Name;
+	}
+	Ar << Source.Cycles;
+	Ar << Source.WorldId;
 
-	RefreshBuiltInAttributes();
+	bool bHasTransform = false;
+	FTransform Transform;
+	Ar << bHasTransform;
+	if (bHasTransform)
+	{
+		Ar << Transform;
+		Source.Transform = &Transform;
+	}
 
-	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
-	if (Settings->bAutoStartSession && State == ESessionState::None)
+	int32 NumAttributes = 0;
+	Ar << NumAttributes;
+	if (Ar.IsError() || NumAttributes < 0 || NumAttributes > Ar.TotalSize() - Ar.Tell())
 	{
-		StartSession({});
+		return nullptr;
+	}
+
+	TArray<FString> Keys;
+	Keys.SetNum(NumAttributes);
+	TArray<FString> Values;
+	Values.SetNum(NumAttributes);
+	TArray<FCachedAttribute> Attributes;
+	Attributes.SetNum(NumAttributes);
+	for (int32 Index = 0; Index < NumAttributes; ++Index)
+	{
+		uint8 Type = 0;
+		Ar << Attributes[Index].KeyId;
+		if (Attributes[Index].KeyId == INDEX_NONE)
+		{
+			Ar << Keys[Index];
+			Attributes[Index].Key = Keys[Index];
+		}
+		Ar << Type;
+		if (Type > static_cast<uint8>(FCachedAttribute::EType::JsonFragment))
+		{
+			return nullptr;
+		}
+
+		Attributes[Index].Type = static_cast<FCachedAttribute::EType>(Type);
+		if (Attributes[Index].Type == FCachedAttribute::EType::String || Attributes[Index].Type == FCachedAttribute::EType::JsonFragment)
+		{
+			Ar << Values[Index];
+			Attributes[Index].Value = Values[Index];
+		}
+		else
+		{
+			Ar << Attributes[Index].IntegerValue;
+		}
+	}
+
+	if (Ar.IsError())
+	{
+		return nullptr;
 	}
+
+	Source.Attributes = Attributes;
+	return CopyToArena(Source);
 }
 
-void FCtcAnalyticsProvider::OnEnginePreExit()
+bool FCtcAnalyticsProvider::AdmitEvent(FStringView EventName, int32 NameId, int32 EventSize, bool& bOutSpill)
 {
-	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnEnginePreExit called. Ending session and sending cached events."));
+	const int64 MaxMemory = MaxCachedEventsMemory.load(std::memory_order_relaxed);
+	const int64 Memory = PendingEventsMemory.load(std::memory_order_relaxed) + EventSize;
+	const ECtcAnalyticsOverflowPolicy Policy = OverflowPolicy.load(std::memory_order_relaxed);
 
-	RecordEvent(TEXT("EngineExit"), TArray<FAnalyticsEventAttribute>());
-
-	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
-	if (Settings->bAutoStartSession && State == ESessionState::Started)
+	if (Policy == ECtcAnalyticsOverflowPolicy::Downsample && Memory > MaxMemory / 2 && Memory <= MaxMemory && !ShouldKeepDownsampledEvent(NameId))
 	{
-		EndSession();
+		UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Event %.*s was dropped by downsampling because the event cache is filling up."), EventName.Len(), EventName.GetData());
+		NumDownsampledEvents.fetch_add(1, std::memory_order_relaxed);
+		return false;
 	}
 
+	if (Memory <= MaxMemory)
+	{
+		return true;
+	}
 
-	SendCachedEvents(true);
+	switch (Policy)
+	{
+	case ECtcAnalyticsOverflowPolicy::DropOldest:
+		EvictOldestEvents(EventSize);
+		return true;
+	case ECtcAnalyticsOverflowPolicy::SpillToDisk:
+		bOutSpill = true;
+		return true;
+	default:
+		UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Event %.*s was dropped because the event cache is full."), EventName.Len(), EventName.GetData());
+		NumOverflowDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+}
 
-	Reset();
+bool FCtcAnalyticsProvider::ShouldKeepDownsampledEvent(int32 NameId)
+{
+	FScopeLock ScopeLock(&DownsampleLock);
+	uint32& Counter = DownsampleCounters.FindOrAdd(NameId);
+	return Counter++ % static_cast<uint32>(DownsampleRate.load(std::memory_order_relaxed)) == 0;
 }
 
-void FCtcAnalyticsProvider::OnSystemError()
+void FCtcAnalyticsProvider::EvictOldestEvents(int32 Size)
 {
-	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnSystemError called. Sending cached events."));
+	const int64 MaxMemory = MaxCachedEventsMemory.load(std::memory_order_relaxed);
+
+	int32 NumEvicted = 0;
+	{
+		FScopeLock ScopeLock(&DequeueLock);
 
-	RecordEvent(TEXT("SystemError"), TArray<FAnalyticsEventAttribute>());
+		while (PendingEventsMemory.load(std::memory_order_relaxed) + Size > MaxMemory)
+		{
+			FCachedEvent* EvictedEvent = PendingEvents.Dequeue();
+			if (!EvictedEvent)
+			{
+				break;
+			}
+
+			// NOTE: The memory is only reclaimed when the arena is reset, the event is no longer counted against the budget though
+			PendingEventsMemory.fetch_sub(EvictedEvent->MemorySize, std::memory_order_relaxed);
+			EvictedEvent->Arena->ReleaseReferences(1);
+			++NumEvicted;
+		}
+	}
 
-	SendCachedEvents(true);
+	NumPendingEvents.fetch_sub(NumEvicted, std::memory_order_relaxed);
+	NumOverflowDroppedEvents.fetch_add(NumEvicted, std::memory_order_relaxed);
 }
 
-void FCtcAnalyticsProvider::OnApplicationWillTerminate()
+void FCtcAnalyticsProvider::RefreshEventFilter()
 {
-	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnApplicationWillTerminate called. Sending cached events."));
-
-	RecordEvent(TEXT("ApplicationWillTerminate"), TArray<FAnalyticsEventAttribute>());
+	EventFilter.Configure(*GetDefault<UCtcSharedSettings>());
+	EventFilter.SetSessionId(GetSessionID());
+}
 
-	SendCachedEvents(true);
+void FCtcAnalyticsProvider::RefreshCacheLimits()
+{
+	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+	MaxCachedEventsMemory.store(Settings->MaxCachedEventsMemory, std::memory_order_relaxed);
+	OverflowPolicy.store(Settings->OverflowPolicy, std::memory_order_relaxed);
+	DownsampleRate.store(FMath::Max(Settings->DownsampleRate, 1), std::memory_order_relaxed);
+	FlushEventThreshold.store(Settings->FlushEventThreshold, std::memory_order_relaxed);
+	FlushMemoryThreshold.store(Settings->FlushMemoryThreshold, std::memory_order_relaxed);
+	SpillFile.SetMaxSize(Settings->MaxSpillFileSize);
+	Outbox.SetLimits(Settings->MaxOutboxSize, Settings->MaxOutboxSegmentAge);
 }
 
-void FCtcAnalyticsProvider::OnWorldBeginPlay(UWorld* World)
+bool FCtcAnalyticsProvider::OnFlushTimer(float DeltaTime)
 {
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::OnFlushTimer);
+
 	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
-	if (!Settings->bAutoWorldChangeTracking)
+	RefreshCacheLimits();
+
+	// The first flush comes right after the provider is created, once the analytics module is done with it.
+	if (AcceptState.load(std::memory_order_relaxed) == EAcceptState::Unknown)
 	{
-		return;
+		ResolveAcceptState();
 	}
 
-	const FString WorldPath = World->GetOutermost()->GetPathName();
-	if (WorldPath.IsEmpty() || WorldPath.StartsWith(TEXT("/Temp/Untitled")))
+	// Flushing during a hitch or a map load makes it worse. Push it back a bit, unless it was already pushed back for too long
+	const double Now = FPlatformTime::Seconds();
+	const bool bFrameOverBudget = FApp::GetDeltaTime() * 1000.0 > Settings->FlushFrameBudget || IsAsyncLoading();
+	if (bFrameOverBudget && (FlushDeferredSince == 0.0 || Now - FlushDeferredSince < Settings->MaxFlushDeferral))
 	{
-		return;
+		if (FlushDeferredSince == 0.0)
+		{
+			FlushDeferredSince = Now;
+		}
+		ScheduleFlush(FlushDeferralStep);
+		return false;
 	}
+	FlushDeferredSince = 0.0;
+
+	const int32 NumFlushedEvents = NumPendingEvents.load(std::memory_order_relaxed);
+	SendCachedEvents();
+
+	// Back off while there is barely anything to send, go back to the regular interval as soon as it picks up
+	const bool bNearlyEmpty = NumFlushedEvents < FMath::Max(Settings->FlushEventThreshold / 100, 1);
+	const double MaxIdleSendInterval = FMath::Max(Settings->MaxIdleSendInterval, Settings->SendInterval);
+	CurrentSendInterval = bNearlyEmpty ? FMath::Min(FMath::Max<double>(CurrentSendInterval, Settings->SendInterval) * 2.0, MaxIdleSendInterval) : Settings->SendInterval;
+
+	// NOTE: Events recorded during the flush may have crossed a threshold again, their early flush must not be pushed back
+	ScheduleFlush(CurrentSendInterval, true);
+
+	return false;
+}
+
+void FCtcAnalyticsProvider::ScheduleFlush(double Delay, bool bKeepEarlyFlush)
+{
+	FScopeLock ScopeLock(&FlushTimerLock);
 
-	if (World->WorldType != EWorldType::Game && World->WorldType != EWorldType::PIE)
+	// The flag is read with the lock held. A request raised after this point arms its own timer once the lock is released
+	if (bKeepEarlyFlush && bEarlyFlushRequested.load(std::memory_order_relaxed))
 	{
-		return;
+		Delay = 0.0;
 	}
 
-	RecordEvent(TEXT("WorldStart"), TArray<FAnalyticsEventAttribute>());
+	FTSTicker::RemoveTicker(FlushTimerHandle);
+	FlushTimerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FCtcAnalyticsProvider::OnFlushTimer), static_cast<float>(Delay));
+	NextFlushTime = FPlatformTime::Seconds() + Delay;
 }
 
-void FCtcAnalyticsProvider::OnWorldEndPlay(UWorld* World)
+bool FCtcAnalyticsProvider::TickDebugDisplay(float DeltaTime)
 {
-	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
-	if (!Settings->bAutoWorldChangeTracking)
+	if (!CVarCtcAnalyticsPrintDebugFlags.GetValueOnGameThread() || !GEngine)
 	{
-		return;
+		return true;
 	}
 
-	const FString WorldPath = World->GetOutermost()->GetPathName();
-	if (WorldPath.IsEmpty() || WorldPath.StartsWith(TEXT("/Temp/Untitled")))
+	double NextFlushIn;
 	{
-		return;
+		FScopeLock ScopeLock(&FlushTimerLock);
+		NextFlushIn = NextFlushTime - FPlatformTime::Seconds();
 	}
 
-	if (World->WorldType != EWorldType::Game && World->WorldType != EWorldType::PIE)
+	TArray<FString> DebugFlags;
+	DebugFlags.Add(TEXT("Cast To Cloud Analytics"));
+	DebugFlags.Add(FString::Printf(TEXT("SessionId: %s"), *GetSessionID()));
+	DebugFlags.Add(FString::Printf(TEXT("UserId: %s"), *GetUserID()));
+	DebugFlags.Add(FString::Printf(TEXT("Events in cache: %s"), *LexToString(NumPendingEvents.load(std::memory_order_relaxed))));
+	DebugFlags.Add(FString::Printf(TEXT("Spilled to disk: %lld bytes"), SpillFile.GetSize()));
+	DebugFlags.Add(FString::Printf(TEXT("Batches acknowledged: %d/%d"), SendScheduler.GetAcknowledgedSequence(GetSessionID()) + 1, NextBatchSequence.load(std::memory_order_relaxed)));
+	DebugFlags.Add(FString::Printf(TEXT("Next flush in: %.2f"), NextFlushIn));
+
+	// NOTE: Keyed messages replace the previous ones instead of piling up, so they only need refreshing at the display interval
+	for (int32 Index = 0; Index < DebugFlags.Num(); ++Index)
 	{
-		return;
+		GEngine->AddOnScreenDebugMessage(DebugDisplayFirstKey + Index, DebugDisplayInterval * 2.0f, FColor::Black, DebugFlags[Index], false);
 	}
 
-	RecordEvent(TEXT("WorldEnd"), TArray<FAnalyticsEventAttribute>());
-}
-
-void FCtcAnalyticsProvider::Reset()
-{
-	State = ESessionState::None;
-	UserID.Reset();
-	SessionID.Reset();
+	return true;
 }
 
-bool FCtcAnalyticsProvider::IsActiveProvider() const
+void FCtcAnalyticsProvider::SendCachedEvents(TOptional<double> WaitDeadline)
 {
-	TSharedPtr<IAnalyticsProvider> Provider = FAnalytics::Get().GetDefaultConfiguredProvider();
-	return Provider.IsValid() && Provider.Get() == this;
-}
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::SendCachedEvents);
 
-void FCtcAnalyticsProvider::OnEventResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bSuccess)
-{
-	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::OnEventResponse);
+	LastFlushTime = FPlatformTime::Seconds();
+	bEarlyFlushRequested.store(false, std::memory_order_relaxed);
 
-	// TODO: Implement a retry system via HttpRetryManager
-	if (!bSuccess || !Response || !Response.IsValid())
+	if (NumPendingEvents.load(std::memory_order_relaxed) == 0)
 	{
-		UE_LOG(LogCtcAnalytics, Error, TEXT("Sending events to backend failed."));
 		return;
 	}
-	if (!EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+
+	if (!UserID.IsSet())
+	{
+		const FString UniqueUserId = FGenericPlatformMisc::GetLoginId();
+		SetUserID(UniqueUserId);
+	}
+
+	if (!SessionID.IsSet())
+	{
+		SetSessionID(FGuid::NewGuid().ToString());
+	}
+
+	// NOTE: Everything below runs on worker threads. The game thread only hands over the context and launches the pipeline.
+	const TSharedRef<const FBatchContext> Context = GetBatchContext();
+
+	// Finished flushes still hold their batch, and the batch keeps its events' arena from being reused
+	InFlightFlushes.RemoveAll(
+		[](const UE::Tasks::FTask& Task)
+		{
+			return Task.IsCompleted();
+		}
+	);
+
+	// The snapshot runs inside a pipe to guarantee PendingEvents only ever has a single consumer. Serializing in the same stage
+	// hands out the request sequences in the order the events were drained
+	UE::Tasks::TTask<TSharedRef<FBatch>> SerializeTask = FlushPipe.Launch(
+		UE_SOURCE_LOCATION,
+		[this, Context]()
+		{
+			TSharedRef<FBatch> Batch = SnapshotPendingEvents(Context);
+			SerializeBatch(*Batch);
+			return Batch;
+		}
+	);
+
+	UE::Tasks::TTask<TSharedRef<FBatch>> CompressTask = UE::Tasks::Launch(
+		UE_SOURCE_LOCATION,
+		[SerializeTask]()
+		{
+			TSharedRef<FBatch> Batch = SerializeTask.GetResult();
+			CompressBatch(*Batch);
+			return Batch;
+		},
+		UE::Tasks::Prerequisites(SerializeTask)
+	);
+
+	// NOTE: Batches compress in parallel but are dispatched one after another, file sink appends and outbox segments keep the flush order
+	if (WaitDeadline.IsSet())
+	{
+		// NOTE: Building the batch and the earlier dispatches count against the deadline too. A batch which isn't ready by then
+		// is dispatched in the background like any other, it only reaches the outbox if the process lives long enough
+		auto GetRemainingTime = [&WaitDeadline]()
+		{
+			return FTimespan::FromSeconds(FMath::Max(*WaitDeadline - FPlatformTime::Seconds(), 0.0));
+		};
+		if (CompressTask.Wait(GetRemainingTime()) && LastDispatchTask.Wait(GetRemainingTime()))
+		{
+			DispatchBatch(CompressTask.GetResult(), WaitDeadline);
+			return;
+		}
+
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("The last batch wasn't ready before the shutdown flush deadline, dispatching it in the background."));
+	}
+
+	LastDispatchTask = UE::Tasks::Launch(
+		UE_SOURCE_LOCATION,
+		[this, CompressTask]()
+		{
+			DispatchBatch(CompressTask.GetResult(), {});
+		},
+		UE::Tasks::Prerequisites(CompressTask, LastDispatchTask)
+	);
+
+	InFlightFlushes.Add(LastDispatchTask);
+}
+
+void FCtcAnalyticsProvider::SendCriticalEvents()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::SendCriticalEvents);
+
+	bCriticalFlushRequested.store(false, std::memory_order_relaxed);
+
+	if (CriticalEvents.IsEmpty())
 	{
-		UE_LOG(LogCtcAnalytics, Error, TEXT("Request to send events to backend failed with code: %d body: {%s}"), Response->GetResponseCode(), *Response->GetContentAsString());
 		return;
 	}
 
-	UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Sending events to backend successful. Response: {%s}"), *Response->GetContentAsString());
+	if (!UserID.IsSet())
+	{
+		SetUserID(FGenericPlatformMisc::GetLoginId());
+	}
+
+	if (!SessionID.IsSet())
+	{
+		SetSessionID(FGuid::NewGuid().ToString());
+	}
+
+	const TSharedRef<FBatch> Batch = MakeShared<FBatch>(GetBatchContext());
+	Batch->Destination = Batch->Context->SendPolicy.Destination;
+	Batch->bCritical = true;
+
+	while (FCachedEvent* CriticalEvent = CriticalEvents.Dequeue())
+	{
+		Batch->Events.Add(CriticalEvent);
+	}
+	Batch->ClockAnchor = FClockAnchor::Capture();
+
+	// NOTE: The batch is tiny so it's prepared inline. Dispatching it persists it in the outbox before the record call returns,
+	// and it never waits behind the bulk lane's pipe
+	SerializeBatch(*Batch);
+	CompressBatch(*Batch);
+	DispatchBatch(Batch, {});
+}
+
+FCtcAnalyticsProvider::FClockAnchor FCtcAnalyticsProvider::FClockAnchor::Capture()
+{
+	FClockAnchor Anchor;
+	Anchor.Cycles = FPlatformTime::Cycles64();
+	Anchor.Time = FDateTime::UtcNow();
+	return Anchor;
+}
+
+FDateTime FCtcAnalyticsProvider::FClockAnchor::ToDateTime(uint64 EventCycles) const
+{
+	// NOTE: Signed difference, an event recorded by another thread can be slightly newer than the anchor
+	const double Offset = static_cast<double>(static_cast<int64>(EventCycles - Cycles)) * FPlatformTime::GetSecondsPerCycle64();
+	return Time + FTimespan(static_cast<int64>(Offset * ETimespan::TicksPerSecond));
+}
+
+TSharedRef<const FCtcAnalyticsProvider::FBatchContext> FCtcAnalyticsProvider::GetBatchContext()
+{
+	if (!BatchContext.IsValid())
+	{
+		const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+
+		TSharedRef<FBatchContext> NewContext = MakeShared<FBatchContext>();
+		NewContext->SessionID = GetSessionID();
+		NewContext->UserID = GetUserID();
+
+		// The values, and the keys which don't fit in AttributeKeys, are reserved upfront so the properties can point to them
+		NewContext->ConstantEventPropertyValues.Reserve((BuiltInEventAttributes.Num() + DefaultAttributes.Num()) * 2);
+		TArray<FCachedAttribute, TInlineAllocator<32>> Properties;
+		TMap<FStringView, int32> PropertyIndices;
+		auto AddProperty = [this, &NewContext, &Properties, &PropertyIndices](const FString& Key, const FString& Value, bool bJsonFragment)
+		{
+			const int32 KeyId = AttributeKeys.Intern(Key);
+			const FString& ContextKey = KeyId == INDEX_NONE ? NewContext->ConstantEventPropertyValues.Add_GetRef(Key) : Key;
+			const FString& ContextValue = NewContext->ConstantEventPropertyValues.Add_GetRef(Value);
+			MergeProperty(Properties, PropertyIndices, bJsonFragment ? FCachedAttribute::MakeJsonFragment(KeyId, ContextKey, ContextValue) : FCachedAttribute::MakeString(KeyId, ContextKey, ContextValue));
+		};
+		for (const TTuple<FString, FString>& Attribute : BuiltInEventAttributes)
+		{
+			AddProperty(Attribute.Key, Attribute.Value, false);
+		}
+		for (const FAnalyticsEventAttribute& Attribute : DefaultAttributes)
+		{
+			AddProperty(Attribute.GetName(), Attribute.GetValue(), Attribute.IsJsonFragment());
+		}
+		NewContext->ConstantEventProperties.Append(Properties);
+		for (const FCachedAttribute& Property : Properties)
+		{
+			NewContext->ConstantEventPropertyKeys.Add(GetFoldedKeyId(Property));
+		}
+		NewContext->bTypedAttributeValues = Settings->bTypedAttributeValues;
+
+		// Escape everything that doesn't change between events once, batches only copy the bytes
+		FCtcAnalyticsJsonEncoder SessionEncoder(NewContext->SessionFieldsFragment);
+		SessionEncoder.WriteStringField(TEXT("session_id"), NewContext->SessionID);
+		SessionEncoder.WriteStringField(TEXT("user_id"), NewContext->UserID);
+
+		FCtcAnalyticsJsonEncoder EventPropertiesEncoder(NewContext->EventPropertiesFragment);
+		for (const FCachedAttribute& Property : NewContext->ConstantEventProperties)
+		{
+			WriteProperty(EventPropertiesEncoder, Property, NewContext->bTypedAttributeValues);
+		}
+
+		FCtcAnalyticsJsonEncoder UserPropertiesEncoder(NewContext->UserPropertiesFragment);
+		UserPropertiesEncoder.BeginObject();
+		for (const TTuple<FString, FString>& Attribute : BuildInUserAttributes)
+		{
+			UserPropertiesEncoder.WriteStringField(Attribute.Key, Attribute.Value);
+		}
+		UserPropertiesEncoder.EndObject();
+
+		NewContext->SendPolicy = SendPolicy;
+		NewContext->bEnableGeolocationAttribution = Settings->bEnableGeolocationAttribution;
+		NewContext->WireFormat = Settings->WireFormat;
+		NewContext->Compression = Settings->Compression;
+		NewContext->CompressionLevel = Settings->CompressionLevel;
+		NewContext->MaxBatchSize = Settings->MaxBatchSize;
+		NewContext->MaxBatchEvents = Settings->MaxBatchEvents;
+		NewContext->bHighPrecisionTimestamps = Settings->bHighPrecisionTimestamps;
+		NewContext->bSendBatchSequence = Settings->bSendBatchSequence;
+
+		BatchContext = NewContext;
+	}
+
+	return BatchContext.ToSharedRef();
+}
+
+TSharedRef<FCtcAnalyticsProvider::FBatch> FCtcAnalyticsProvider::SnapshotPendingEvents(const TSharedRef<const FBatchContext>& Context)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::SnapshotPendingEvents);
+
+	TSharedRef<FBatch> Batch = MakeShared<FBatch>(Context);
+
+	// Events recorded from now on go to another arena. This one is reset once the events drained below are all released
+	RotateEventArenas();
+
+	// Drain everything recorded so far in a single pass. Events recorded concurrently will be picked up by the next flush
+	Batch->Events.Reserve(NumPendingEvents.load(std::memory_order_relaxed) + 1);
+	{
+		FScopeLock ScopeLock(&DequeueLock);
+
+		int64 DrainedMemory = 0;
+		while (FCachedEvent* PendingEvent = PendingEvents.Dequeue())
+		{
+			DrainedMemory += PendingEvent->MemorySize;
+			Batch->Events.Add(PendingEvent);
+		}
+		PendingEventsMemory.fetch_sub(DrainedMemory, std::memory_order_relaxed);
+	}
+	NumPendingEvents.fetch_sub(Batch->Events.Num(), std::memory_order_relaxed);
+
+	// Spilled events were recorded once the cache was full, they go after the ones kept in memory
+	if (const int32 NumSpilled = NumSpilledEvents.exchange(0, std::memory_order_relaxed))
+	{
+		NumPendingEvents.fetch_sub(NumSpilled, std::memory_order_relaxed);
+
+		UE_LOG(LogCtcAnalytics, Verbose, TEXT("Reading back %d events spilled to disk, %lld bytes"), NumSpilled, SpillFile.GetSize());
+
+		// NOTE: Read a block at a time, the file can be much bigger than the in-memory cache it overflowed from
+		FCtcAnalyticsSpillFile::FReader SpillReader = SpillFile.TakeContents();
+		TArray<uint8> SpilledRecords;
+		while (SpillReader.ReadRecords(SpilledRecords))
+		{
+			FMemoryReader Reader(SpilledRecords);
+			while (!Reader.AtEnd())
+			{
+				FCachedEvent* SpilledEvent = LoadSpilledEvent(Reader);
+				if (!SpilledEvent)
+				{
+					UE_LOG(LogCtcAnalytics, Error, TEXT("Spilled events are corrupted, discarding the remaining %lld bytes of the block."), Reader.TotalSize() - Reader.Tell());
+					break;
+				}
+				Batch->Events.Add(SpilledEvent);
+			}
+		}
+	}
+	NumOverflowDroppedEvents.fetch_add(SpillFile.TakeNumLostRecords(), std::memory_order_relaxed);
+
+	// Report what was lost since the last flush along with the surviving events
+	const int32 NumBacklogDropped = NumDroppedEvents.exchange(0, std::memory_order_relaxed);
+	const int32 NumOverflowDropped = NumOverflowDroppedEvents.exchange(0, std::memory_order_relaxed);
+	const int32 NumDownsampled = NumDownsampledEvents.exchange(0, std::memory_order_relaxed);
+	const int32 NumRateLimited = NumRateLimitedEvents.exchange(0, std::memory_order_relaxed);
+	const int32 NumLostCrash = NumLostCrashEvents.exchange(0, std::memory_order_relaxed);
+	if (NumBacklogDropped > 0 || NumOverflowDropped > 0 || NumDownsampled > 0 || NumRateLimited > 0 || NumLostCrash > 0)
+	{
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Dropped events since the last flush. Send backlog full: %d, event cache full: %d, downsampled: %d, rate limited: %d, crash dump unavailable: %d."), NumBacklogDropped, NumOverflowDropped, NumDownsampled, NumRateLimited, NumLostCrash);
+
+		const FCachedAttribute Attributes[] = {
+			FCachedAttribute::MakeInteger(AttributeKeys.Intern(TEXT("send_backlog")), TEXT("send_backlog"), NumBacklogDropped),
+			FCachedAttribute::MakeInteger(AttributeKeys.Intern(TEXT("cache_overflow")), TEXT("cache_overflow"), NumOverflowDropped),
+			FCachedAttribute::MakeInteger(AttributeKeys.Intern(TEXT("downsampled")), TEXT("downsampled"), NumDownsampled),
+			FCachedAttribute::MakeInteger(AttributeKeys.Intern(TEXT("rate_limited")), TEXT("rate_limited"), NumRateLimited),
+			FCachedAttribute::MakeInteger(AttributeKeys.Intern(TEXT("crash_dump")), TEXT("crash_dump"), NumLostCrash),
+		};
+
+		FCachedEvent DropReport;
+		DropReport.NameId = EventNames.Intern(TEXT("EventsDropped"));
+		DropReport.Name = DropReport.NameId == INDEX_NONE ? TEXT("EventsDropped") : FStringView();
+		DropReport.Cycles = FPlatformTime::Cycles64();
+		DropReport.Attributes = Attributes;
+		Batch->Events.Add(CopyToArena(DropReport));
+	}
+
+	// NOTE: Only read the wall clock once per batch. Events are ordered by the monotonic clock, unaffected by clock adjustments
+	Batch->ClockAnchor = FClockAnchor::Capture();
+
+	Batch->Destination = Context->SendPolicy.Destination;
+
+	return Batch;
+}
+
+void FCtcAnalyticsProvider::SerializeBatch(FBatch& Batch)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::SerializeBatch);
+
+	// NOTE: We don't spend any time building discarded batches
+	if (Batch.Events.IsEmpty() || Batch.Destination == EBatchDestination::Discard)
+	{
+		return;
+	}
+
+	const FBatchContext& Context = *Batch.Context;
+
+	UE_LOG(LogCtcAnalytics, Verbose, TEXT("Serializing %s cached events"), *LexToString(Batch.Events.Num()));
+
+	const bool bIsBackend = Batch.Destination == EBatchDestination::Backend;
+
+	// NOTE: Local sinks always get the expanded per-event shape, regardless of the format used to talk with the backend
+	const bool bSharedContext = bIsBackend && Context.WireFormat == ECtcAnalyticsWireFormat::SharedContext;
+
+	// Only requests need to be split, local sinks get the whole batch at once
+	const int32 MaxChunkEvents = bIsBackend ? FMath::Max(Context.MaxBatchEvents, 1) : MAX_int32;
+	const int64 MaxChunkSize = bIsBackend ? Context.MaxBatchSize : MAX_int64;
+
+	Batch.Chunks.Reset();
+	int32 EventIndex = 0;
+	while (EventIndex < Batch.Events.Num())
+	{
+		FBatchChunk& Chunk = Batch.Chunks.AddDefaulted_GetRef();
+		Chunk.Sequence = bIsBackend ? NextBatchSequence.fetch_add(1, std::memory_order_relaxed) : INDEX_NONE;
+		Chunk.Body.Reserve(FMath::Min(Batch.Events.Num() - EventIndex, MaxChunkEvents) * EstimatedBytesPerEvent);
+
+		FCtcAnalyticsJsonEncoder Encoder(Chunk.Body);
+		if (bIsBackend)
+		{
+			Encoder.BeginObject();
+			if (bSharedContext)
+			{
+				Encoder.WriteNumberField(TEXT("version"), SharedContextWireVersion);
+				Encoder.WriteKey(TEXT("context"));
+				Encoder.BeginObject();
+				Encoder.WriteRaw(Context.SessionFieldsFragment);
+				Encoder.WriteKey(TEXT("event_properties"));
+				Encoder.BeginObject();
+				Encoder.WriteRaw(Context.EventPropertiesFragment);
+				Encoder.EndObject();
+				Encoder.WriteKey(TEXT("user_properties"));
+				Encoder.WriteRaw(Context.UserPropertiesFragment);
+				Encoder.EndObject();
+			}
+			Encoder.WriteKey(TEXT("eventsPayload"));
+		}
+
+		Encoder.BeginArray();
+		for (; EventIndex < Batch.Events.Num() && Chunk.EventSpans.Num() < MaxChunkEvents; ++EventIndex)
+		{
+			const int32 SizeBeforeEvent = Chunk.Body.Num();
+			const int32 EventStart = SizeBeforeEvent + (Chunk.EventSpans.IsEmpty() ? 0 : 1);
+
+			SerializeEvent(Encoder, *Batch.Events[EventIndex], Context, Batch.ClockAnchor, bSharedContext);
+
+			// An event which doesn't fit moves to the next chunk, unless it's too big to fit anywhere
+			if (Chunk.Body.Num() + MaxChunkTrailerSize > MaxChunkSize && !Chunk.EventSpans.IsEmpty())
+			{
+				Chunk.Body.SetNum(SizeBeforeEvent, EAllowShrinking::No);
+				break;
+			}
+
+			Chunk.EventSpans.Emplace(EventStart, Chunk.Body.Num() - EventStart);
+		}
+		Encoder.EndArray();
+
+		if (bIsBackend)
+		{
+			Encoder.WriteBoolField(TEXT("geoTracking"), Context.bEnableGeolocationAttribution);
+			if (Context.bSendBatchSequence)
+			{
+				Encoder.WriteNumberField(TEXT("sequence"), Chunk.Sequence);
+			}
+			Encoder.EndObject();
+		}
+	}
+}
+
+void FCtcAnalyticsProvider::SerializeEvent(FCtcAnalyticsJsonEncoder& Encoder, const FCachedEvent& Event, const FBatchContext& Context, const FClockAnchor& ClockAnchor, bool bSharedContext, bool bMergeProperties) const
+{
+	Encoder.BeginObject();
+	Encoder.WriteKey(TEXT("event_name"));
+	if (Event.NameId == INDEX_NONE)
+	{
+		Encoder.WriteString(Event.Name);
+	}
+	else
+	{
+		Encoder.WriteRaw(EventNames.GetEscapedName(Event.NameId));
+	}
+	Encoder.WriteKey(TEXT("created_at"));
+	Encoder.WriteDateTime(ClockAnchor.ToDateTime(Event.Cycles), Context.bHighPrecisionTimestamps);
+	if (!bSharedContext)
+	{
+		Encoder.WriteRaw(Context.SessionFieldsFragment);
+	}
+
+	// Merge the event's properties with the default attributes. Event attributes are appended last so they can override
+	Encoder.WriteKey(TEXT("event_properties"));
+	Encoder.BeginObject();
+	if (bSharedContext)
+	{
+		// The constant properties travel once in the batch context, the event only carries its own attributes
+		WriteEventProperties(Encoder, Event, {}, {}, {}, Context.bTypedAttributeValues);
+	}
+	else if (bMergeProperties)
+	{
+		WriteEventProperties(Encoder, Event, Context.ConstantEventProperties, Context.ConstantEventPropertyKeys, Context.EventPropertiesFragment, Context.bTypedAttributeValues);
+	}
+	else
+	{
+		// NOTE: Merging allocates. Colliding keys are written twice instead, JSON readers keep the last one which is the attribute
+		Encoder.WriteRaw(Context.EventPropertiesFragment);
+		for (const FCachedAttribute& Attribute : Event.Attributes)
+		{
+			WriteProperty(Encoder, Attribute, Context.bTypedAttributeValues);
+		}
+	}
+	Encoder.EndObject();
+
+	if (!bSharedContext)
+	{
+		Encoder.WriteKey(TEXT("user_properties"));
+		Encoder.WriteRaw(Context.UserPropertiesFragment);
+	}
+
+	Encoder.WriteKey(TEXT("world"));
+	Encoder.WriteRaw(WorldNames.GetEscapedName(Event.WorldId));
+
+	if (Event.Transform)
+	{
+		const FVector Position = Event.Transform->GetTranslation();
+		Encoder.WriteNumberField(TEXT("position_x"), Position.X);
+		Encoder.WriteNumberField(TEXT("position_y"), Position.Y);
+		Encoder.WriteNumberField(TEXT("position_z"), Position.Z);
+
+		const FQuat Rotation = Event.Transform->GetRotation();
+		Encoder.WriteNumberField(TEXT("rotation_x"), Rotation.X);
+		Encoder.WriteNumberField(TEXT("rotation_y"), Rotation.Y);
+		Encoder.WriteNumberField(TEXT("rotation_z"), Rotation.Z);
+		Encoder.WriteNumberField(TEXT("rotation_w"), Rotation.W);
+	}
+	Encoder.EndObject();
+}
+
+void FCtcAnalyticsProvider::WriteEventProperties(FCtcAnalyticsJsonEncoder& Encoder, const FCachedEvent& Event, TConstArrayView<FCachedAttribute> ConstantProperties, const TSet<int32>& ConstantPropertyKeys, TConstArrayView<uint8> ConstantPropertiesFragment, bool bTypedValues) const
+{
+	// Folded IDs make the collision check a few integer comparisons. Keys which aren't interned always go through the merge
+	bool bRequiresMerge = ConstantPropertyKeys.Contains(INDEX_NONE);
+	for (int32 Index = 0; Index < Event.Attributes.Num() && !bRequiresMerge; ++Index)
+	{
+		const int32 FoldedKeyId = GetFoldedKeyId(Event.Attributes[Index]);
+		bRequiresMerge = FoldedKeyId == INDEX_NONE || ConstantPropertyKeys.Contains(FoldedKeyId);
+		for (int32 OtherIndex = Index + 1; OtherIndex < Event.Attributes.Num() && !bRequiresMerge; ++OtherIndex)
+		{
+			bRequiresMerge = FoldedKeyId == GetFoldedKeyId(Event.Attributes[OtherIndex]);
+		}
+	}
+
+	if (bRequiresMerge)
+	{
+		// Same merge as the one building the constant properties, event attributes override them in place
+		TArray<FCachedAttribute, TInlineAllocator<32>> EventProperties;
+		TMap<FStringView, int32> EventPropertyIndices;
+		for (const FCachedAttribute& Property : ConstantProperties)
+		{
+			MergeProperty(EventProperties, EventPropertyIndices, Property);
+		}
+		for (const FCachedAttribute& Attribute : Event.Attributes)
+		{
+			MergeProperty(EventProperties, EventPropertyIndices, Attribute);
+		}
+		for (const FCachedAttribute& Property : EventProperties)
+		{
+			WriteProperty(Encoder, Property, bTypedValues);
+		}
+		return;
+	}
+
+	Encoder.WriteRaw(ConstantPropertiesFragment);
+	for (const FCachedAttribute& Attribute : Event.Attributes)
+	{
+		WriteProperty(Encoder, Attribute, bTypedValues);
+	}
+}
+
+void FCtcAnalyticsProvider::MergeProperty(TArray<FCachedAttribute, TInlineAllocator<32>>& Properties, TMap<FStringView, int32>& PropertyIndices, const FCachedAttribute& Property) const
+{
+	// NOTE: The default key functions of FStringView ignore case, like the FString keys of FJsonObject
+	if (const int32* ExistingIndex = PropertyIndices.Find(GetKey(Property)))
+	{
+		Properties[*ExistingIndex] = Property;
+	}
+	else
+	{
+		PropertyIndices.Add(GetKey(Property), Properties.Add(Property));
+	}
+}
+
+void FCtcAnalyticsProvider::WriteProperty(FCtcAnalyticsJsonEncoder& Encoder, const FCachedAttribute& Attribute, bool bTypedValues) const
+{
+	if (Attribute.KeyId == INDEX_NONE)
+	{
+		Encoder.WriteKey(Attribute.Key);
+	}
+	else
+	{
+		Encoder.WriteEscapedKey(AttributeKeys.GetEscapedName(Attribute.KeyId));
+	}
+	WriteAttributeValue(Encoder, Attribute, bTypedValues);
+}
+
+FStringView FCtcAnalyticsProvider::GetKey(const FCachedAttribute& Attribute) const
+{
+	return Attribute.KeyId == INDEX_NONE ? Attribute.Key : FStringView(AttributeKeys.GetName(Attribute.KeyId));
+}
+
+int32 FCtcAnalyticsProvider::GetFoldedKeyId(const FCachedAttribute& Attribute) const
+{
+	return Attribute.KeyId == INDEX_NONE ? INDEX_NONE : AttributeKeys.GetFoldedId(Attribute.KeyId);
+}
+
+void FCtcAnalyticsProvider::WriteAttributeValue(FCtcAnalyticsJsonEncoder& Encoder, const FCachedAttribute& Attribute, bool bTypedValues)
+{
+	if (bTypedValues)
+	{
+		switch (Attribute.Type)
+		{
+		case FCachedAttribute::EType::Integer:
+			Encoder.WriteInteger(Attribute.IntegerValue);
+			return;
+		case FCachedAttribute::EType::Number:
+			// NOTE: JSON has no representation for NaN and infinity, those stay strings
+			if (FMath::IsFinite(Attribute.NumberValue))
+			{
+				Encoder.WriteNumber(Attribute.NumberValue);
+				return;
+			}
+			break;
+		case FCachedAttribute::EType::Bool:
+			Encoder.WriteBool(Attribute.IntegerValue != 0);
+			return;
+		case FCachedAttribute::EType::JsonFragment:
+			// NOTE: An empty fragment isn't valid JSON
+			if (!Attribute.Value.IsEmpty())
+			{
+				Encoder.WriteRaw(Attribute.Value);
+				return;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Otherwise the value is sent as a string. Unboxed values are only formatted here, into a buffer on the stack
+	switch (Attribute.Type)
+	{
+	case FCachedAttribute::EType::Integer:
+	{
+		TStringBuilder<32> Builder;
+		Builder.Appendf(TEXT("%lld"), static_cast<long long>(Attribute.IntegerValue));
+		Encoder.WriteString(Builder.ToView());
+		break;
+	}
+	case FCachedAttribute::EType::Number:
+	{
+		TStringBuilder<32> Builder;
+		Builder.Appendf(TEXT("%.17g"), Attribute.NumberValue);
+		Encoder.WriteString(Builder.ToView());
+		break;
+	}
+	case FCachedAttribute::EType::Bool:
+		Encoder.WriteString(Attribute.IntegerValue ? TEXT("true") : TEXT("false"));
+		break;
+	default:
+		Encoder.WriteString(Attribute.Value);
+		break;
+	}
+}
+
+void FCtcAnalyticsProvider::CompressBatch(FBatch& Batch)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::CompressBatch);
+
+	// NOTE: Local sinks are meant to be human readable so only the backend requests get compressed
+	if (Batch.Destination != EBatchDestination::Backend || Batch.Context->Compression == ECtcAnalyticsCompression::None)
+	{
+		return;
+	}
+
+	ParallelFor(
+		Batch.Chunks.Num(),
+		[&Batch](int32 ChunkIndex)
+		{
+			FBatchChunk& Chunk = Batch.Chunks[ChunkIndex];
+
+			TArray<uint8> CompressedBody;
+			Chunk.ContentEncoding = FCtcAnalyticsCompression::Compress(Batch.Context->Compression, Batch.Context->CompressionLevel, Chunk.Body, CompressedBody);
+			if (Chunk.ContentEncoding != ECtcAnalyticsCompression::None)
+			{
+				UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Compressed batch body from %d to %d bytes"), Chunk.Body.Num(), CompressedBody.Num());
+				Chunk.Body = MoveTemp(CompressedBody);
+			}
+		}
+	);
+}
+
+void FCtcAnalyticsProvider::DispatchBatch(const TSharedRef<FBatch>& Batch, TOptional<double> WaitDeadline)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::DispatchBatch);
+
+	if (Batch->Events.IsEmpty())
+	{
+		return;
+	}
+
+	const FBatchContext& Context = *Batch->Context;
+
+	if (Batch->Destination == EBatchDestination::File)
+	{
+		for (FBatchChunk& Chunk : Batch->Chunks)
+		{
+			FileSink.Append(Context.SessionID, ConvertToNewlineDelimited(MoveTemp(Chunk.Body), Chunk.EventSpans));
+		}
+		if (WaitDeadline.IsSet())
+		{
+			FileSink.WaitForPendingWrites();
+		}
+		return;
+	}
+
+	if (Batch->Destination == EBatchDestination::Log)
+	{
+		for (const FBatchChunk& Chunk : Batch->Chunks)
+		{
+			PrintEventsToLog(Context.SessionID, Chunk.Body, Chunk.EventSpans);
+		}
+		return;
+	}
+
+	if (Batch->Destination == EBatchDestination::Discard)
+	{
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Skipping %s events for session %s because current configuration is not allowed"), *LexToString(Batch->Events.Num()), *Context.SessionID);
+		return;
+	}
+
+	for (FBatchChunk& Chunk : Batch->Chunks)
+	{
+		FCtcAnalyticsOutboundRequest Request = MakeOutboundRequest(Context);
+		Request.ContentEncoding = Chunk.ContentEncoding;
+		Request.SessionID = Context.SessionID;
+		Request.Sequence = Chunk.Sequence;
+		Request.bCritical = Batch->bCritical;
+
+		// Persist the chunk before it leaves, if the application dies or the request fails it gets uploaded on the next launch
+		Request.SegmentPath = Outbox.Store(Chunk.Body, Chunk.ContentEncoding);
+		Request.Body = MoveTemp(Chunk.Body);
+
+		if (WaitDeadline.IsSet())
+		{
+			SendScheduler.SendAndWait(MoveTemp(Request), *WaitDeadline);
+		}
+		else
+		{
+			SendScheduler.Enqueue(MoveTemp(Request));
+		}
+	}
+}
+
+int32 FCtcAnalyticsProvider::GetMaxSerializedSize(const FCachedEvent& Event, const FBatchContext& Context) const
+{
+	// NOTE: A character takes at most 6 bytes once escaped. The fixed part covers the field names and the transform
+	constexpr int32 MaxBytesPerChar = 6;
+	constexpr int32 FixedSize = 512;
+	constexpr int32 MaxUnboxedValueSize = 32;
+
+	int32 NumChars = 0;
+	int32 NumEscapedBytes = WorldNames.GetEscapedName(Event.WorldId).Num();
+	if (Event.NameId == INDEX_NONE)
+	{
+		NumChars += Event.Name.Len() + 2;
+	}
+	else
+	{
+		NumEscapedBytes += EventNames.GetEscapedName(Event.NameId).Num();
+	}
+	for (const FCachedAttribute& Attribute : Event.Attributes)
+	{
+		NumChars += Attribute.Value.Len() + 3;
+		if (Attribute.KeyId == INDEX_NONE)
+		{
+			NumChars += Attribute.Key.Len() + 2;
+		}
+		else
+		{
+			NumEscapedBytes += AttributeKeys.GetEscapedName(Attribute.KeyId).Num();
+		}
+		NumEscapedBytes += 1 + (Attribute.Type != FCachedAttribute::EType::String ? MaxUnboxedValueSize : 0);
+	}
+
+	return FixedSize + NumChars * MaxBytesPerChar + NumEscapedBytes + Context.SessionFieldsFragment.Num() + Context.EventPropertiesFragment.Num() + Context.UserPropertiesFragment.Num();
+}
+
+bool FCtcAnalyticsProvider::WriteCrashDump(const TCHAR* EventName)
+{
+	// NOTE: Runs inside crash handlers. The buffer and the file were prepared upfront, every write below is checked against
+	// the buffer capacity so it never grows, and nothing goes through HTTP. The next launch uploads the crash segment
+	TArray<uint8>* Buffer = Outbox.GetCrashBuffer();
+	const FBatchContext* Context = BatchContext.Get();
+	if (!bCrashDumpEnabled || !Buffer || !Context)
+	{
+		return false;
+	}
+
+	const int32 Capacity = Buffer->Max() - MaxChunkTrailerSize;
+	const int32 WorldId = CurrentWorldId.load(std::memory_order_relaxed);
+	const int32 CrashEventSize = 512 + FCString::Strlen(EventName) * 6 + Context->SessionFieldsFragment.Num() + Context->EventPropertiesFragment.Num() + Context->UserPropertiesFragment.Num() + WorldNames.GetEscapedName(WorldId).Num();
+	if (CrashDumpEventsEnd + CrashEventSize > Capacity)
+	{
+		return false;
+	}
+
+	// A dump following another one, e.g.: WillTerminate then SystemError, reopens the events array to append its own events
+	const bool bAppend = CrashDumpEventsEnd > 0;
+	Buffer->SetNum(CrashDumpEventsEnd, EAllowShrinking::No);
+
+	const FClockAnchor ClockAnchor = FClockAnchor::Capture();
+
+	FCtcAnalyticsJsonEncoder Encoder(*Buffer, bAppend);
+	if (!bAppend)
+	{
+		Encoder.BeginObject();
+		Encoder.WriteKey(TEXT("eventsPayload"));
+		Encoder.BeginArray();
+	}
+
+	// The event describing the crash goes first, it's the one we can least afford to lose
+	Encoder.BeginObject();
+	Encoder.WriteStringField(TEXT("event_name"), EventName);
+	Encoder.WriteKey(TEXT("created_at"));
+	Encoder.WriteDateTime(ClockAnchor.Time, Context->bHighPrecisionTimestamps);
+	Encoder.WriteRaw(Context->SessionFieldsFragment);
+	Encoder.WriteKey(TEXT("event_properties"));
+	Encoder.BeginObject();
+	Encoder.WriteRaw(Context->EventPropertiesFragment);
+	Encoder.EndObject();
+	Encoder.WriteKey(TEXT("user_properties"));
+	Encoder.WriteRaw(Context->UserPropertiesFragment);
+	Encoder.WriteKey(TEXT("world"));
+	Encoder.WriteRaw(WorldNames.GetEscapedName(WorldId));
+	Encoder.EndObject();
+
+	// Events are only written once unlinked from their queue, the ones which don't fit stay queued
+	auto WriteQueuedEvents = [this, Buffer, Capacity, Context, &ClockAnchor, &Encoder](TCtcAnalyticsEventQueue<FCachedEvent>& Queue)
+	{
+		int32 NumWritten = 0;
+		int64 WrittenMemory = 0;
+		while (const FCachedEvent* Event = Queue.Peek())
+		{
+			if (Buffer->Num() + GetMaxSerializedSize(*Event, *Context) > Capacity)
+			{
+				break;
+			}
+
+			// An event which can't be unlinked yet is still being enqueued, stop there
+			if (!Queue.Dequeue())
+			{
+				break;
+			}
+
+			SerializeEvent(Encoder, *Event, *Context, ClockAnchor, false, false);
+			WrittenMemory += Event->MemorySize;
+			++NumWritten;
+			Event->Arena->ReleaseReferences(1);
+		}
+		return TPair<int32, int64>(NumWritten, WrittenMemory);
+	};
+
+	// NOTE: The critical queue is only consumed from the game thread
+	if (IsInGameThread())
+	{
+		WriteQueuedEvents(CriticalEvents);
+	}
+
+	// NOTE: If a flush is draining the pending events right now they're already gone, waiting on it could deadlock
+	if (DequeueLock.TryLock())
+	{
+		const TPair<int32, int64> Written = WriteQueuedEvents(PendingEvents);
+		NumPendingEvents.fetch_sub(Written.Key, std::memory_order_relaxed);
+		PendingEventsMemory.fetch_sub(Written.Value, std::memory_order_relaxed);
+		DequeueLock.Unlock();
+	}
+
+	CrashDumpEventsEnd = Buffer->Num();
+	Encoder.EndArray();
+	Encoder.WriteBoolField(TEXT("geoTracking"), Context->bEnableGeolocationAttribution);
+	Encoder.EndObject();
+
+	return Outbox.CommitCrashSegment();
+}
+
+FCtcAnalyticsOutboundRequest FCtcAnalyticsProvider::MakeOutboundRequest(const FBatchContext& Context)
+{
+	FCtcAnalyticsOutboundRequest Request;
+	Request.Url = Context.SendPolicy.EventsUrl;
+	Request.ApiKey = Context.SendPolicy.ApiKey;
+	return Request;
+}
+
+void FCtcAnalyticsProvider::UploadRecoveredSegments()
+{
+	const TSharedRef<const FBatchContext> Context = GetBatchContext();
+	if (Context->SendPolicy.Destination != EBatchDestination::Backend)
+	{
+		return;
+	}
+
+	UE::Tasks::FTask RecoveryTask = UE::Tasks::Launch(
+		UE_SOURCE_LOCATION,
+		[this, Context]()
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::UploadRecoveredSegments);
+
+			// NOTE: Only the paths are queued, the scheduler loads every segment right before sending it
+			for (const FString& SegmentPath : Outbox.TakeRecoveredSegments())
+			{
+				UE_LOG(LogCtcAnalytics, Verbose, TEXT("Queueing outbox segment %s left by a previous session."), *SegmentPath);
+
+				FCtcAnalyticsOutboundRequest Request = MakeOutboundRequest(*Context);
+				Request.SegmentPath = SegmentPath;
+				SendScheduler.Enqueue(MoveTemp(Request));
+			}
+		}
+	);
+
+	InFlightFlushes.Add(RecoveryTask);
+}
+
+#if WITH_EDITOR
+void FCtcAnalyticsProvider::OnPIEStarted(bool bIsSimulating)
+{
+	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnPIEStarted called. Starting session."));
+
+	RefreshBuiltInAttributes();
+	UploadRecoveredSegments();
+
+	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+	if (Settings->bAutoStartSession && State == ESessionState::None)
+	{
+		StartSession({});
+	}
+}
+#endif
+
+#if WITH_EDITOR
+void FCtcAnalyticsProvider::OnPIEEnded(bool bIsSimulating)
+{
+	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnPIEEnded called. Ending session and sending cached events."));
+
+	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+	if (Settings->bAutoStartSession && State == ESessionState::Started)
+	{
+		EndSession();
+	}
+
+	FlushForShutdown();
+
+	Reset();
+}
+#endif
+
+#if WITH_EDITOR
+void FCtcAnalyticsProvider::OnSettingsChanged(UObject* Settings, FPropertyChangedEvent& PropertyChangedEvent)
+{
+	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnSettingsChanged called. Resolving the send policy, event filter and cache limits again."));
+
+	RefreshSendPolicy();
+	ResolveAcceptState();
+	RefreshEventFilter();
+	RefreshCacheLimits();
+}
+#endif
+
+void FCtcAnalyticsProvider::OnPostEngineInit()
+{
+	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnPostEngineInit called. Starting session."));
+
+	RefreshBuiltInAttributes();
+	UploadRecoveredSegments();
+
+	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+	if (Settings->bAutoStartSession && State == ESessionState::None)
+	{
+		StartSession({});
+	}
+
+	// Crash-time data can only reach the backend through the outbox, local sinks keep using the regular flush
+	bCrashDumpEnabled = SendPolicy.Destination == EBatchDestination::Backend;
+	if (bCrashDumpEnabled)
+	{
+		Outbox.PrepareCrashSegment(Settings->CrashBufferSize);
+	}
+}
+
+void FCtcAnalyticsProvider::OnEnginePreExit()
+{
+	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnEnginePreExit called. Ending session and sending cached events."));
+
+	RecordEvent(TEXT("EngineExit"), TArray<FAnalyticsEventAttribute>());
+
+	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+	if (Settings->bAutoStartSession && State == ESessionState::Started)
+	{
+		EndSession();
+	}
+
+	FlushForShutdown();
+
+	// The application is exiting normally, there won't be any crash to persist. A dump committed by WillTerminate is kept
+	bCrashDumpEnabled = false;
+	Outbox.DiscardCrashSegment();
+	CrashDumpEventsEnd = 0;
+
+	Reset();
+}
+
+void FCtcAnalyticsProvider::OnSystemError()
+{
+	// NOTE: Nothing else is safe here, the event is lost rather than allocated, serialized or sent over HTTP
+	if (!WriteCrashDump(TEXT("SystemError")))
+	{
+		NumLostCrashEvents.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnSystemError called. Persisted cached events."));
+}
+
+void FCtcAnalyticsProvider::OnApplicationWillTerminate()
+{
+	// NOTE: Nothing else is safe here, the event is lost rather than allocated, serialized or sent over HTTP
+	if (!WriteCrashDump(TEXT("ApplicationWillTerminate")))
+	{
+		NumLostCrashEvents.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	UE_LOG(LogCtcAnalytics, Verbose, TEXT("OnApplicationWillTerminate called. Persisted cached events."));
+}
+
+void FCtcAnalyticsProvider::FlushForShutdown()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsProvider::FlushForShutdown);
+
+	const double StartTime = FPlatformTime::Seconds();
+	const double Deadline = StartTime + GetDefault<UCtcSharedSettings>()->ShutdownFlushTimeout;
+
+	// NOTE: Whatever isn't sent by the deadline is already persisted in the outbox and goes out on the next launch
+	if (IsInGameThread())
+	{
+		SendCriticalEvents();
+	}
+	SendCachedEvents(Deadline);
+	if (IsInGameThread())
+	{
+		SendScheduler.WaitForInFlightRequests(Deadline);
+	}
+
+	LastShutdownFlushDuration = FPlatformTime::Seconds() - StartTime;
+	UE_LOG(LogCtcAnalytics, Log, TEXT("Shutdown flush added %.1fms to the exit."), LastShutdownFlushDuration * 1000.0);
+}
+
+void FCtcAnalyticsProvider::OnWorldBeginPlay(UWorld* World)
+{
+	// NOTE: The world name is resolved once here. Events recorded from any thread only copy its ID
+	if (const UPackage* Package = World->GetPackage())
+	{
+		CurrentWorld = World;
+		// NOTE: Events only carry the ID of their world. A run loading more distinct worlds than the table holds sends the
+		// extra ones empty
+		const int32 WorldId = WorldNames.Intern(UWorld::StripPIEPrefixFromPackageName(Package->GetName(), World->StreamingLevelsPrefix));
+		CurrentWorldId.store(WorldId != INDEX_NONE ? WorldId : FCtcAnalyticsNameTable::EmptyId, std::memory_order_relaxed);
+	}
+
+	if (ShouldTrackWorldChange(World))
+	{
+		RecordEvent(TEXT("WorldStart"), TArray<FAnalyticsEventAttribute>());
+	}
+}
+
+void FCtcAnalyticsProvider::OnWorldEndPlay(UWorld* World)
+{
+	if (ShouldTrackWorldChange(World))
+	{
+		RecordEvent(TEXT("WorldEnd"), TArray<FAnalyticsEventAttribute>());
+	}
+
+	if (World == CurrentWorld)
+	{
+		CurrentWorld = nullptr;
+		CurrentWorldId.store(FCtcAnalyticsNameTable::EmptyId, std::memory_order_relaxed);
+	}
+}
+
+bool FCtcAnalyticsProvider::ShouldTrackWorldChange(const UWorld* World)
+{
+	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+	if (!Settings->bAutoWorldChangeTracking)
+	{
+		return false;
+	}
+
+	const FString WorldPath = World->GetOutermost()->GetPathName();
+	if (WorldPath.IsEmpty() || WorldPath.StartsWith(TEXT("/Temp/Untitled")))
+	{
+		return false;
+	}
+
+	return World->WorldType == EWorldType::Game || World->WorldType == EWorldType::PIE;
+}
+
+void FCtcAnalyticsProvider::Reset()
+{
+	// Everything from this session was already flushed, make sure it reaches the disk before the next one starts
+	FileSink.Close();
+
+	State = ESessionState::None;
+	UserID.Reset();
+	SessionID.Reset();
+	BatchContext.Reset();
+	NextBatchSequence = 0;
+	ResolveAcceptState();
+	RefreshEventFilter();
+}
+
+void FCtcAnalyticsProvider::ResolveAcceptState()
+{
+	AcceptState.store(QueryAcceptState() ? EAcceptState::Accepting : EAcceptState::Rejecting, std::memory_order_relaxed);
+}
+
+bool FCtcAnalyticsProvider::TryAcceptOnGameThread() const
+{
+	if (!QueryAcceptState())
+	{
+		return false;
+	}
+
+	AcceptState.store(EAcceptState::Accepting, std::memory_order_relaxed);
+	return true;
+}
+
+bool FCtcAnalyticsProvider::QueryAcceptState() const
+{
+	check(IsInGameThread());
+
+	TSharedPtr<IAnalyticsProvider> Provider = FAnalytics::Get().GetDefaultConfiguredProvider();
+	return Provider.IsValid() && Provider.Get() == this && bIsSendingAllowed;
 }
@@ -0,0 +1,140 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsRecordingBenchmarkCommandlet.h"
+
+#include <AnalyticsEventAttribute.h>
+#include <HAL/MemoryBase.h>
+#include <Misc/Paths.h>
+
+#include "CtcAnalyticsLog.h"
+#include "CtcAnalyticsProvider.h"
+#include "CtcAnalyticsTypedEvent.h"
+#include "Tests/CtcAnalyticsProviderTestAccess.h"
+
+namespace
+{
+	struct FBenchmarkHitEvent
+	{
+		static constexpr const TCHAR* CtcEventName = TEXT("BenchmarkHit");
+		static constexpr auto CtcEventFields() { return CtcAnalyticsFields(CtcAnalyticsField(TEXT("damage"), &FBenchmarkHitEvent::Damage), CtcAnalyticsField(TEXT("combo"), &FBenchmarkHitEvent::Combo)); }
+
+		float Damage = 12.5f;
+		int32 Combo = 0;
+	};
+
+	thread_local bool bCountAllocations = false;
+	thread_local int32 NumCountedAllocations = 0;
+
+	/**
+	 * Forwards everything to the allocator it wraps, counting the allocations made by the threads which asked for it
+	 */
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		explicit FCountingMalloc(FMalloc* InInnerMalloc) : InnerMalloc(InInnerMalloc) {}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			NumCountedAllocations += bCountAllocations ? 1 : 0;
+			return InnerMalloc->Malloc(Count, Alignment);
+		}
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			NumCountedAllocations += bCountAllocations && Count > 0 ? 1 : 0;
+			return InnerMalloc->Realloc(Original, Count, Alignment);
+		}
+		virtual void Free(void* Original) override { InnerMalloc->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return InnerMalloc->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return InnerMalloc->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { InnerMalloc->Trim(bTrimThreadCaches); }
+		virtual bool IsInternallyThreadSafe() const override { return InnerMalloc->IsInternallyThreadSafe(); }
+		virtual const TCHAR* GetDescriptiveName() override { return InnerMalloc->GetDescriptiveName(); }
+
+	private:
+		FMalloc* InnerMalloc;
+	};
+
+	/**
+	 * Routes every allocation of the process through the counting proxy, until the process exits
+	 */
+	void InstallCountingMalloc()
+	{
+		// NOTE: Never uninstalled nor destroyed, other threads keep allocating through it. It forwards to the allocator it
+		// replaces, memory allocated before or after the exchange is freed by the same allocator either way
+		FCountingMalloc* CountingMalloc = new FCountingMalloc(GMalloc);
+		FPlatformAtomics::InterlockedExchangePtr(reinterpret_cast<void**>(&GMalloc), CountingMalloc);
+	}
+
+	TArray<FAnalyticsEventAttribute> MakeAttributes()
+	{
+		TArray<FAnalyticsEventAttribute> Attributes;
+		for (int32 Index = 0; Index < 6; ++Index)
+		{
+			Attributes.Emplace(FString::Printf(TEXT("benchmark_attribute_%02d"), Index * 13), LexToString(Index * 31));
+		}
+		return Attributes;
+	}
+} // namespace
+
+int32 UCtcAnalyticsRecordingBenchmarkCommandlet::Main(const FString& Params)
+{
+#if PLATFORM_USES_FIXED_GMalloc_CLASS
+	UE_LOG(LogCtcAnalytics, Warning, TEXT("Allocations can't be counted, calls to the allocator don't go through GMalloc on this platform."));
+	return 0;
+#else
+	constexpr int32 NumCalls = 1000;
+	constexpr int32 NumWarmUpRounds = 2;
+
+	InstallCountingMalloc();
+
+	FCtcAnalyticsProvider Provider(FPaths::ProjectIntermediateDir() / TEXT("CtcAnalyticsRecordingBenchmark"));
+	FCtcAnalyticsProviderTestAccess::StartRecording(Provider);
+
+	const TArray<FAnalyticsEventAttribute> Attributes = MakeAttributes();
+	const FString Weapon = TEXT("Crossbow");
+	FBenchmarkHitEvent HitEvent;
+
+	struct FRecorder
+	{
+		const TCHAR* Name;
+		TFunction<void(int32)> Record;
+	};
+	const FRecorder Recorders[] = {
+		{TEXT("RecordEvent"), [&Provider, &Attributes](int32 Index) { Provider.RecordEvent(FStringView(TEXT("BenchmarkAttributes")), Attributes); }},
+		{TEXT("Record"), [&Provider, &Weapon](int32 Index) { Provider.Record(TEXT("BenchmarkRecord"), TEXT("damage"), 12.5f, TEXT("weapon"), Weapon, TEXT("critical"), true, TEXT("combo"), Index); }},
+		{TEXT("RecordTyped"), [&Provider, &HitEvent](int32 Index) { HitEvent.Combo = Index; Provider.RecordTyped(HitEvent); }},
+	};
+
+	int32 NumAllocatingRecorders = 0;
+	for (const FRecorder& Recorder : Recorders)
+	{
+		// NOTE: The warm-up rounds fill the name lookup caches and grow both event arenas. Flushes keep the blocks of an
+		// arena around, the measured round reuses the ones of the first warm-up round
+		for (int32 Round = 0; Round < NumWarmUpRounds; ++Round)
+		{
+			for (int32 Index = 0; Index < NumCalls; ++Index)
+			{
+				Recorder.Record(Index);
+			}
+			FCtcAnalyticsProviderTestAccess::DropPendingEvents(Provider);
+		}
+
+		NumCountedAllocations = 0;
+		bCountAllocations = true;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < NumCalls; ++Index)
+		{
+			Recorder.Record(Index);
+		}
+		const double Duration = FPlatformTime::Seconds() - StartTime;
+		bCountAllocations = false;
+		FCtcAnalyticsProviderTestAccess::DropPendingEvents(Provider);
+
+		UE_LOG(LogCtcAnalytics, Display, TEXT("%s: %.0fns and %.2f allocations per call over %d calls."), Recorder.Name, Duration * 1e9 / NumCalls, static_cast<double>(NumCountedAllocations) / NumCalls, NumCalls);
+		NumAllocatingRecorders += NumCountedAllocations > 0 ? 1 : 0;
+	}
+
+	// NOTE: Recording allocates nothing in steady state, a non zero exit code lets a build machine catch regressions
+	return NumAllocatingRecorders > 0 ? 1 : 0;
+#endif
+}
@@ -0,0 +1,460 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsSendScheduler.h"
+
+#include <HttpManager.h>
+#include <HttpModule.h>
+#include <Interfaces/IHttpResponse.h>
+#include <Tasks/Task.h>
+
+#include "CtcAnalyticsCompression.h"
+#include "CtcAnalyticsLog.h"
+#include "CtcAnalyticsOutbox.h"
+
+namespace
+{
+	/**
+	 * Whether a response code means the request can never succeed, e.g.: a malformed body
+	 */
+	bool IsPermanentFailure(int32 ResponseCode)
+	{
+		const bool bIsClientError = ResponseCode >= EHttpResponseCodes::BadRequest && ResponseCode < EHttpResponseCodes::ServerError;
+		return bIsClientError && ResponseCode != EHttpResponseCodes::RequestTimeout && ResponseCode != EHttpResponseCodes::TooManyRequests;
+	}
+
+	/**
+	 * Ticks the HTTP module until IsDone returns true or Deadline passes. Unlike ProcessRequestUntilComplete it can't hang
+	 * for the whole HTTP timeout on a slow or unreachable network
+	 * @return Whether IsDone returned true before the deadline
+	 */
+	bool TickHttpUntil(TFunctionRef<bool()> IsDone, double Deadline)
+	{
+		double LastTime = FPlatformTime::Seconds();
+		while (!IsDone())
+		{
+			const double Now = FPlatformTime::Seconds();
+			if (Now >= Deadline)
+			{
+				return false;
+			}
+
+			FHttpModule::Get().GetHttpManager().Tick(static_cast<float>(Now - LastTime));
+			LastTime = Now;
+			FPlatformProcess::SleepNoStats(0.005f);
+		}
+		return true;
+	}
+} // namespace
+
+FCtcAnalyticsSendScheduler::FCtcAnalyticsSendScheduler(FCtcAnalyticsOutbox& InOutbox) : Outbox(InOutbox)
+{
+}
+
+FCtcAnalyticsSendScheduler::~FCtcAnalyticsSendScheduler()
+{
+	TArray<UE::Tasks::FTask> PendingLoads;
+	{
+		FScopeLock ScopeLock(&Lock);
+		bShuttingDown = true;
+		PendingLoads = MoveTemp(LoadTasks);
+	}
+
+	FTSTicker::RemoveTicker(ResumeTickerHandle);
+
+	// Loads start their request once done, they need to be over before the requests in flight are collected
+	UE::Tasks::Wait(PendingLoads);
+
+	TArray<FHttpRequestPtr> RequestsToCancel;
+	{
+		FScopeLock ScopeLock(&Lock);
+		RequestsToCancel = MoveTemp(InFlightRequests);
+	}
+
+	// NOTE: The completion callbacks point to this scheduler, they're unbound so cancelling can't call back into it. Outbox
+	// segments of the cancelled requests are kept for the next launch
+	for (const FHttpRequestPtr& HttpRequest : RequestsToCancel)
+	{
+		HttpRequest->OnProcessRequestComplete().Unbind();
+		HttpRequest->CancelRequest();
+	}
+}
+
+void FCtcAnalyticsSendScheduler::Enqueue(FCtcAnalyticsOutboundRequest&& Request)
+{
+	BacklogBytes.fetch_add(Request.Body.Num(), std::memory_order_relaxed);
+
+	{
+		FScopeLock ScopeLock(&Lock);
+		InsertInQueue(MakeShared<FCtcAnalyticsOutboundRequest>(MoveTemp(Request)), false);
+	}
+
+	Pump();
+}
+
+void FCtcAnalyticsSendScheduler::SendAndWait(FCtcAnalyticsOutboundRequest&& Request, double Deadline)
+{
+	if (FPlatformTime::Seconds() >= Deadline)
+	{
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("No time left to send events to backend, they will be sent by the next launch."));
+		return;
+	}
+
+	const TSharedRef<FCtcAnalyticsOutboundRequest> SharedRequest = MakeShared<FCtcAnalyticsOutboundRequest>(MoveTemp(Request));
+	const FHttpRequestRef HttpRequest = CreateHttpRequest(*SharedRequest);
+	HttpRequest->SetTimeout(static_cast<float>(Deadline - FPlatformTime::Seconds()));
+	HttpRequest->ProcessRequest();
+
+	const bool bFinished = TickHttpUntil(
+		[&HttpRequest]()
+		{
+			return EHttpRequestStatus::IsFinished(HttpRequest->GetStatus());
+		},
+		Deadline
+	);
+	if (!bFinished)
+	{
+		HttpRequest->CancelRequest();
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Sending events to backend timed out, they will be sent by the next launch."));
+		return;
+	}
+
+	const FHttpResponsePtr Response = HttpRequest->GetResponse();
+	const bool bSuccess = HttpRequest->GetStatus() == EHttpRequestStatus::Succeeded && Response.IsValid();
+	if (bSuccess && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		Outbox.Remove(SharedRequest->SegmentPath);
+		Acknowledge(*SharedRequest);
+	}
+	else
+	{
+		// NOTE: There is no time left to retry, the outbox segment will be sent by the next launch
+		UE_LOG(LogCtcAnalytics, Error, TEXT("Sending events to backend failed with code: %d."), Response ? Response->GetResponseCode() : 0);
+	}
+}
+
+void FCtcAnalyticsSendScheduler::WaitForInFlightRequests(double Deadline)
+{
+	TickHttpUntil(
+		[this]()
+		{
+			FScopeLock ScopeLock(&Lock);
+			return NumInFlight == 0;
+		},
+		Deadline
+	);
+}
+
+bool FCtcAnalyticsSendScheduler::IsBackpressured() const
+{
+	return BacklogBytes.load(std::memory_order_relaxed) > MaxBacklogBytes.load(std::memory_order_relaxed);
+}
+
+int32 FCtcAnalyticsSendScheduler::GetAcknowledgedSequence(const FString& SessionID) const
+{
+	FScopeLock ScopeLock(&Lock);
+	const FSessionAcks* Acks = SessionAcks.Find(SessionID);
+	return Acks ? Acks->NextExpected - 1 : INDEX_NONE;
+}
+
+void FCtcAnalyticsSendScheduler::Pump()
+{
+	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+	MaxBacklogBytes.store(Settings->MaxSendBacklogSize, std::memory_order_relaxed);
+
+	// NOTE: Only the queue is touched with the lock held, loading and starting the requests happens once it's released
+	TArray<TSharedRef<FCtcAnalyticsOutboundRequest>> RequestsToStart;
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		if (bShuttingDown)
+		{
+			return;
+		}
+
+		// NOTE: Critical requests are always at the front of the queue, so the bulk lane can't hold them back
+		const double Now = FPlatformTime::Seconds();
+		int32 NumCritical = 0;
+		while (NumCritical < Queue.Num() && Queue[NumCritical]->bCritical)
+		{
+			++NumCritical;
+		}
+
+		const int32 NumCriticalToStart = Now >= CriticalPausedUntil ? NumCritical : 0;
+		int32 NumBulkToStart = 0;
+		if (Now >= BulkPausedUntil)
+		{
+			const int32 NumFreeSlots = FMath::Max(Settings->MaxInFlightRequests, 1) - NumInFlight - NumCriticalToStart;
+			NumBulkToStart = FMath::Clamp(NumFreeSlots, 0, Queue.Num() - NumCritical);
+		}
+
+		RequestsToStart.Append(Queue.GetData(), NumCriticalToStart);
+		RequestsToStart.Append(Queue.GetData() + NumCritical, NumBulkToStart);
+		Queue.RemoveAt(NumCritical, NumBulkToStart, EAllowShrinking::No);
+		Queue.RemoveAt(0, NumCriticalToStart, EAllowShrinking::No);
+		NumInFlight += RequestsToStart.Num();
+	}
+
+	for (const TSharedRef<FCtcAnalyticsOutboundRequest>& Request : RequestsToStart)
+	{
+		// Recovered requests are only loaded once they're about to be sent to keep large offline backlogs out of memory. The
+		// segment is read on a worker thread, Pump runs on the game thread more often than not
+		if (Request->Body.IsEmpty() && !Request->SegmentPath.IsEmpty())
+		{
+			LoadAndStartRequest(Request);
+		}
+		else
+		{
+			StartRequest(Request);
+		}
+	}
+}
+
+void FCtcAnalyticsSendScheduler::LoadAndStartRequest(const TSharedRef<FCtcAnalyticsOutboundRequest>& Request)
+{
+	// NOTE: Launched with the lock held so the destructor either waits for the load or the load never starts
+	FScopeLock ScopeLock(&Lock);
+	if (bShuttingDown)
+	{
+		return;
+	}
+
+	LoadTasks.RemoveAll(
+		[](const UE::Tasks::FTask& Task)
+		{
+			return Task.IsCompleted();
+		}
+	);
+	LoadTasks.Add(UE::Tasks::Launch(
+		UE_SOURCE_LOCATION,
+		[this, Request]()
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsSendScheduler::LoadRecoveredRequest);
+
+			if (!FCtcAnalyticsOutbox::Load(Request->SegmentPath, Request->Body, Request->ContentEncoding))
+			{
+				UE_LOG(LogCtcAnalytics, Warning, TEXT("Discarding unreadable outbox segment %s."), *Request->SegmentPath);
+				Outbox.Remove(Request->SegmentPath);
+				ReleaseInFlightSlot();
+				return;
+			}
+
+			BacklogBytes.fetch_add(Request->Body.Num(), std::memory_order_relaxed);
+			StartRequest(Request);
+		}
+	));
+}
+
+void FCtcAnalyticsSendScheduler::StartRequest(const TSharedRef<FCtcAnalyticsOutboundRequest>& Request)
+{
+	const FHttpRequestRef HttpRequest = CreateHttpRequest(*Request);
+	HttpRequest->OnProcessRequestComplete().BindRaw(this, &FCtcAnalyticsSendScheduler::OnRequestComplete, Request);
+
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (bShuttingDown)
+		{
+			return;
+		}
+		InFlightRequests.Add(HttpRequest);
+	}
+
+	HttpRequest->ProcessRequest();
+}
+
+void FCtcAnalyticsSendScheduler::ReleaseInFlightSlot()
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		--NumInFlight;
+	}
+
+	Pump();
+}
+
+void FCtcAnalyticsSendScheduler::InsertInQueue(const TSharedRef<FCtcAnalyticsOutboundRequest>& Request, bool bRetry)
+{
+	// Critical requests are kept at the front so only the leading ones need counting
+	int32 NumCritical = 0;
+	while (NumCritical < Queue.Num() && Queue[NumCritical]->bCritical)
+	{
+		++NumCritical;
+	}
+
+	if (Request->bCritical)
+	{
+		Queue.Insert(Request, bRetry ? 0 : NumCritical);
+	}
+	else if (bRetry)
+	{
+		Queue.Insert(Request, NumCritical);
+	}
+	else
+	{
+		Queue.Add(Request);
+	}
+}
+
+FHttpRequestRef FCtcAnalyticsSendScheduler::CreateHttpRequest(const FCtcAnalyticsOutboundRequest& Request)
+{
+	FHttpRequestRef HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetVerb(TEXT("POST"));
+	HttpRequest->SetURL(Request.Url);
+	HttpRequest->SetHeader(TEXT("X-API-Key"), Request.ApiKey);
+	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	if (Request.ContentEncoding != ECtcAnalyticsCompression::None)
+	{
+		HttpRequest->SetHeader(TEXT("Content-Encoding"), FCtcAnalyticsCompression::GetContentEncoding(Request.ContentEncoding));
+	}
+	HttpRequest->SetContent(Request.Body);
+
+	return HttpRequest;
+}
+
+void FCtcAnalyticsSendScheduler::OnRequestComplete(FHttpRequestPtr HttpRequest, FHttpResponsePtr Response, bool bSuccess, TSharedRef<FCtcAnalyticsOutboundRequest> Request)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsSendScheduler::OnRequestComplete);
+
+	{
+		FScopeLock ScopeLock(&Lock);
+		InFlightRequests.RemoveSingleSwap(HttpRequest, EAllowShrinking::No);
+	}
+
+	const int32 ResponseCode = bSuccess && Response ? Response->GetResponseCode() : 0;
+
+	if (ResponseCode != 0 && EHttpResponseCodes::IsOk(ResponseCode))
+	{
+		UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Sending events to backend successful. Response: {%s}"), *Response->GetContentAsString());
+		Complete(*Request, true);
+	}
+	else if (ResponseCode != 0 && IsPermanentFailure(ResponseCode))
+	{
+		// The backend rejected the batch itself, sending it again won't help
+		UE_LOG(LogCtcAnalytics, Error, TEXT("Request to send events to backend failed with code: %d body: {%s}"), ResponseCode, *Response->GetContentAsString());
+		Complete(*Request, true);
+	}
+	else if (++Request->Attempt >= GetDefault<UCtcSharedSettings>()->MaxSendAttempts)
+	{
+		// NOTE: The outbox segment is kept so the next launch gets another chance at sending it
+		UE_LOG(LogCtcAnalytics, Error, TEXT("Sending events to backend failed with code: %d. Giving up after %d attempts."), ResponseCode, Request->Attempt);
+		Complete(*Request, false);
+	}
+	else
+	{
+		const double Delay = GetRetryDelay(*Request, Response);
+		UE_LOG(LogCtcAnalytics, Warning, TEXT("Sending events to backend failed with code: %d. Retrying in %.1fs."), ResponseCode, Delay);
+
+		// The whole lane is paused, not only this request. Hammering a struggling backend with the other batches won't help it
+		// recover. A failing critical request holds back the bulk lane too, a failing bulk request never holds back the critical one
+		{
+			FScopeLock ScopeLock(&Lock);
+			const double ResumeTime = FPlatformTime::Seconds() + Delay;
+			BulkPausedUntil = FMath::Max(BulkPausedUntil, ResumeTime);
+			if (Request->bCritical)
+			{
+				CriticalPausedUntil = FMath::Max(CriticalPausedUntil, ResumeTime);
+			}
+			InsertInQueue(Request, true);
+		}
+		ScheduleResume(GetRemainingPause());
+	}
+
+	ReleaseInFlightSlot();
+}
+
+void FCtcAnalyticsSendScheduler::Complete(const FCtcAnalyticsOutboundRequest& Request, bool bRemoveSegment)
+{
+	BacklogBytes.fetch_sub(Request.Body.Num(), std::memory_order_relaxed);
+
+	if (bRemoveSegment)
+	{
+		Outbox.Remove(Request.SegmentPath);
+	}
+
+	// NOTE: Requests given up on are settled too, they belong to the next launch now and must not stall the session
+	Acknowledge(Request);
+}
+
+void FCtcAnalyticsSendScheduler::Acknowledge(const FCtcAnalyticsOutboundRequest& Request)
+{
+	if (Request.Sequence == INDEX_NONE)
+	{
+		return;
+	}
+
+	FScopeLock ScopeLock(&Lock);
+	FSessionAcks& Acks = SessionAcks.FindOrAdd(Request.SessionID);
+	if (Request.Sequence != Acks.NextExpected)
+	{
+		UE_LOG(LogCtcAnalytics, VeryVerbose, TEXT("Request %d of session %s settled ahead of request %d"), Request.Sequence, *Request.SessionID, Acks.NextExpected);
+		Acks.OutOfOrder.Add(Request.Sequence);
+		return;
+	}
+
+	++Acks.NextExpected;
+	while (Acks.OutOfOrder.Remove(Acks.NextExpected) > 0)
+	{
+		++Acks.NextExpected;
+	}
+}
+
+double FCtcAnalyticsSendScheduler::GetRetryDelay(const FCtcAnalyticsOutboundRequest& Request, const FHttpResponsePtr& Response)
+{
+	const UCtcSharedSettings* Settings = GetDefault<UCtcSharedSettings>();
+
+	if (Response)
+	{
+		// Retry-After is either a number of seconds or an HTTP date
+		const FString RetryAfter = Response->GetHeader(TEXT("Retry-After"));
+		if (RetryAfter.IsNumeric())
+		{
+			return FMath::Clamp(FCString::Atod(*RetryAfter), 0.0, static_cast<double>(Settings->RetryMaxDelay));
+		}
+
+		FDateTime RetryDate;
+		if (!RetryAfter.IsEmpty() && FDateTime::ParseHttpDate(RetryAfter, RetryDate))
+		{
+			return FMath::Clamp((RetryDate - FDateTime::UtcNow()).GetTotalSeconds(), 0.0, static_cast<double>(Settings->RetryMaxDelay));
+		}
+	}
+
+	// Exponential backoff with jitter so clients failing at the same time don't come back at the same time
+	const double Backoff = FMath::Min(Settings->RetryBaseDelay * FMath::Pow(2.0, static_cast<double>(Request.Attempt - 1)), static_cast<double>(Settings->RetryMaxDelay));
+	return FMath::FRandRange(Backoff * 0.5, Backoff);
+}
+
+double FCtcAnalyticsSendScheduler::GetRemainingPause() const
+{
+	FScopeLock ScopeLock(&Lock);
+
+	const double Now = FPlatformTime::Seconds();
+	double RemainingPause = MAX_dbl;
+	for (const double PausedUntil : {CriticalPausedUntil, BulkPausedUntil})
+	{
+		if (PausedUntil > Now)
+		{
+			RemainingPause = FMath::Min(RemainingPause, PausedUntil - Now);
+		}
+	}
+	return RemainingPause != MAX_dbl ? RemainingPause : 0.0;
+}
+
+void FCtcAnalyticsSendScheduler::ScheduleResume(double Delay)
+{
+	FTSTicker::RemoveTicker(ResumeTickerHandle);
+	ResumeTickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+		FTickerDelegate::CreateLambda(
+			[this](float DeltaTime)
+			{
+				Pump();
+
+				// The lanes resume at different times, the ticker comes back for the one still paused
+				if (const double RemainingPause = GetRemainingPause(); RemainingPause > 0.0)
+				{
+					ScheduleResume(RemainingPause);
+				}
+				return false;
+			}
+		),
+		static_cast<float>(Delay)
+	);
+}
@@ -0,0 +1,213 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include "CtcAnalyticsSpillFile.h"
+
+#include <GenericPlatform/GenericPlatformFile.h>
+#include <HAL/FileManager.h>
+#include <HAL/PlatformFileManager.h>
+
+#include "CtcAnalyticsLog.h"
+
+namespace
+{
+	const TCHAR* SpillExtension = TEXT(".spill");
+
+	/**
+	 * Every record is prefixed with its size so the reader can stop between two records
+	 */
+	using FRecordHeader = uint32;
+
+	FString MakeSpillPath(const FString& Directory)
+	{
+		return Directory / FGuid::NewGuid().ToString(EGuidFormats::Short) + SpillExtension;
+	}
+} // namespace
+
+FCtcAnalyticsSpillFile::FReader::FReader(FReader&& Other) = default;
+
+FCtcAnalyticsSpillFile::FReader::~FReader()
+{
+	FileHandle.Reset();
+	if (!Path.IsEmpty())
+	{
+		FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*Path);
+	}
+}
+
+bool FCtcAnalyticsSpillFile::FReader::ReadRecords(TArray<uint8>& OutRecords)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsSpillFile::FReader::ReadRecords);
+
+	OutRecords.Reset();
+	while (Offset < Size && OutRecords.Num() < MaxReadSize)
+	{
+		FRecordHeader RecordSize = 0;
+		if (!ReadBytes(&RecordSize, sizeof(RecordSize)) || RecordSize > Size - Offset)
+		{
+			UE_LOG(LogCtcAnalytics, Error, TEXT("Spilled events are corrupted, discarding the remaining %lld bytes."), Size - Offset);
+			Offset = Size;
+			break;
+		}
+
+		const int32 RecordStart = OutRecords.Num();
+		OutRecords.AddUninitialized(RecordSize);
+		if (!ReadBytes(OutRecords.GetData() + RecordStart, RecordSize))
+		{
+			UE_LOG(LogCtcAnalytics, Error, TEXT("Failed to read back spilled events from %s."), *Path);
+			OutRecords.SetNum(RecordStart, EAllowShrinking::No);
+			Offset = Size;
+			break;
+		}
+	}
+
+	return !OutRecords.IsEmpty();
+}
+
+bool FCtcAnalyticsSpillFile::FReader::ReadBytes(void* Data, int64 NumBytes)
+{
+	if (NumBytes > Size - Offset)
+	{
+		return false;
+	}
+
+	if (FileHandle)
+	{
+		if (!FileHandle->Read(static_cast<uint8*>(Data), NumBytes))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		FMemory::Memcpy(Data, Buffer.GetData() + Offset, NumBytes);
+	}
+
+	Offset += NumBytes;
+	return true;
+}
+
+FCtcAnalyticsSpillFile::FCtcAnalyticsSpillFile(const FString& InDirectory) : Directory(InDirectory)
+{
+	Path = MakeSpillPath(Directory);
+}
+
+FCtcAnalyticsSpillFile::~FCtcAnalyticsSpillFile()
+{
+	FileHandle.Reset();
+	if (FileSize > 0)
+	{
+		FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*Path);
+	}
+}
+
+bool FCtcAnalyticsSpillFile::Append(TConstArrayView<uint8> Record)
+{
+	const int64 RecordSize = sizeof(FRecordHeader) + Record.Num();
+
+	FScopeLock ScopeLock(&Lock);
+
+	if (FileSize + Buffer.Num() + RecordSize > MaxSize.load(std::memory_order_relaxed))
+	{
+		return false;
+	}
+
+	// NOTE: The buffer is written before the record is added, a failed write only loses records which were already accepted
+	if (Buffer.Num() + RecordSize > MaxBufferSize && !FlushBuffer())
+	{
+		return false;
+	}
+
+	const FRecordHeader Header = Record.Num();
+	Buffer.Append(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+	Buffer.Append(Record.GetData(), Record.Num());
+	++NumBufferedRecords;
+	SpilledBytes.fetch_add(RecordSize, std::memory_order_relaxed);
+	return true;
+}
+
+FCtcAnalyticsSpillFile::FReader FCtcAnalyticsSpillFile::TakeContents()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FCtcAnalyticsSpillFile::TakeContents);
+
+	FReader Reader;
+
+	FScopeLock ScopeLock(&Lock);
+
+	if (FileSize == 0)
+	{
+		// Everything still fits in the buffer, no need to go through the file
+		Reader.Size = Buffer.Num();
+		Reader.Buffer = MoveTemp(Buffer);
+	}
+	else
+	{
+		FlushBuffer();
+		FileHandle.Reset();
+
+		// NOTE: The records appended while the reader goes through this file are written to a new one
+		Reader.Path = Path;
+		Reader.Size = FileSize;
+		Reader.FileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Reader.Path));
+		if (!Reader.FileHandle)
+		{
+			UE_LOG(LogCtcAnalytics, Error, TEXT("Failed to read back spilled events from %s."), *Reader.Path);
+			Reader.Size = 0;
+		}
+		Path = MakeSpillPath(Directory);
+	}
+
+	Buffer.Empty();
+	NumBufferedRecords = 0;
+	FileSize = 0;
+	SpilledBytes.store(0, std::memory_order_relaxed);
+
+	return Reader;
+}
+
+bool FCtcAnalyticsSpillFile::IsEmpty() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return FileSize == 0 && Buffer.IsEmpty();
+}
+
+bool FCtcAnalyticsSpillFile::FlushBuffer()
+{
+	if (Buffer.IsEmpty())
+	{
+		return true;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!bStaleFilesDeleted)
+	{
+		// Spill files left behind by runs which died before flushing can't be trusted, there is no session to attach them to
+		TArray<FString> StaleNames;
+		IFileManager::Get().FindFiles(StaleNames, *(Directory / TEXT("*") + SpillExtension), true, false);
+		for (const FString& StaleName : StaleNames)
+		{
+			IFileManager::Get().Delete(*(Directory / StaleName), false, false, true);
+		}
+		bStaleFilesDeleted = true;
+	}
+
+	if (!FileHandle)
+	{
+		PlatformFile.CreateDirectoryTree(*Directory);
+		FileHandle.Reset(PlatformFile.OpenWrite(*Path, true));
+	}
+
+	if (!FileHandle || !FileHandle->Write(Buffer.GetData(), Buffer.Num()))
+	{
+		UE_LOG(LogCtcAnalytics, Error, TEXT("Failed to write %d spilled events to %s, they are lost."), NumBufferedRecords, *Path);
+		NumLostRecords.fetch_add(NumBufferedRecords, std::memory_order_relaxed);
+		SpilledBytes.fetch_sub(Buffer.Num(), std::memory_order_relaxed);
+		Buffer.Reset();
+		NumBufferedRecords = 0;
+		return false;
+	}
+
+	FileSize += Buffer.Num();
+	Buffer.Reset();
+	NumBufferedRecords = 0;
+	return true;
+}
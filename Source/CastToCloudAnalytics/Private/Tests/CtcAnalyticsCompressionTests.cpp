@@ -0,0 +1,231 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include <Misc/AutomationTest.h>
+#include <Misc/Compression.h>
+#include <Misc/Paths.h>
+
+THIRD_PARTY_INCLUDES_START
+#include <zlib.h>
+THIRD_PARTY_INCLUDES_END
+
+#include "CtcAnalyticsCompression.h"
+#include "CtcAnalyticsOutbox.h"
+#include "CtcAnalyticsSendScheduler.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CtcAnalyticsStandInEndpoint.h"
+
+namespace
+{
+	/**
+	 * Request body as repetitive as the real ones
+	 */
+	TArray<uint8> MakeRequestBody()
+	{
+		FString Body = TEXT("{\"eventsPayload\":[");
+		for (int32 Index = 0; Index < 500; ++Index)
+		{
+			Body += FString::Printf(TEXT("%s{\"event_name\":\"Hit\",\"created_at\":\"2026-01-02T03:04:05.%03dZ\",\"session_id\":\"5C4B2C8F\",\"event_properties\":{\"damage\":\"%d\"}}"), Index > 0 ? TEXT(",") : TEXT(""), Index, Index * 7);
+		}
+		Body += TEXT("],\"geoTracking\":true}");
+
+		const FTCHARToUTF8 Utf8(*Body, Body.Len());
+		return TArray<uint8>(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	}
+
+	/**
+	 * Decodes a gzip body the way a server honoring Content-Encoding: gzip does
+	 */
+	bool InflateGzip(TConstArrayView<uint8> Compressed, int32 UncompressedSize, TArray<uint8>& OutBody)
+	{
+		z_stream Stream;
+		FMemory::Memzero(Stream);
+		if (inflateInit2(&Stream, MAX_WBITS + 16) != Z_OK)
+		{
+			return false;
+		}
+
+		// NOTE: One extra byte, inflating more than expected must be caught
+		OutBody.SetNumUninitialized(UncompressedSize + 1);
+		Stream.next_in = const_cast<Bytef*>(Compressed.GetData());
+		Stream.avail_in = Compressed.Num();
+		Stream.next_out = OutBody.GetData();
+		Stream.avail_out = OutBody.Num();
+
+		const int32 Result = inflate(&Stream, Z_FINISH);
+		inflateEnd(&Stream);
+
+		OutBody.SetNum(Stream.total_out, EAllowShrinking::No);
+		return Result == Z_STREAM_END;
+	}
+
+	/**
+	 * Decodes a request body according to its Content-Encoding header, the way the backend does
+	 */
+	bool DecodeBody(const FString& ContentEncoding, TConstArrayView<uint8> Body, int32 UncompressedSize, TArray<uint8>& OutBody)
+	{
+		if (ContentEncoding.IsEmpty())
+		{
+			OutBody = TArray<uint8>(Body.GetData(), Body.Num());
+			return true;
+		}
+		if (ContentEncoding == TEXT("gzip"))
+		{
+			return InflateGzip(Body, UncompressedSize, OutBody);
+		}
+		if (ContentEncoding == TEXT("zstd"))
+		{
+			OutBody.SetNumUninitialized(UncompressedSize);
+			return FCompression::UncompressMemory(TEXT("Zstd"), OutBody.GetData(), OutBody.Num(), Body.GetData(), Body.Num());
+		}
+		return false;
+	}
+} // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsCompressionRoundTripTest, "CastToCloud.Analytics.Compression.RoundTrip", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCtcAnalyticsCompressionRoundTripTest::RunTest(const FString& Parameters)
+{
+	const TArray<uint8> Body = MakeRequestBody();
+
+	for (const int32 Level : {1, 6, 9})
+	{
+		TArray<uint8> Compressed;
+		const ECtcAnalyticsCompression Method = FCtcAnalyticsCompression::Compress(ECtcAnalyticsCompression::Gzip, Level, Body, Compressed);
+		if (!TestEqual(FString::Printf(TEXT("Gzip level %d is used"), Level), static_cast<int32>(Method), static_cast<int32>(ECtcAnalyticsCompression::Gzip)))
+		{
+			continue;
+		}
+
+		TestTrue(FString::Printf(TEXT("Gzip level %d has a gzip header"), Level), Compressed.Num() > 2 && Compressed[0] == 0x1F && Compressed[1] == 0x8B);
+		TestTrue(FString::Printf(TEXT("Gzip level %d is at least 5x smaller"), Level), Compressed.Num() * 5 < Body.Num());
+
+		TArray<uint8> Inflated;
+		TestTrue(FString::Printf(TEXT("Gzip level %d inflates"), Level), InflateGzip(Compressed, Body.Num(), Inflated));
+		TestTrue(FString::Printf(TEXT("Gzip level %d inflates to the original body"), Level), Inflated == Body);
+	}
+
+	// NOTE: The engine has no built-in Zstd codec, it's only covered when a project registers one
+	if (FCompression::IsFormatValid(TEXT("Zstd")))
+	{
+		TArray<uint8> Compressed;
+		const ECtcAnalyticsCompression Method = FCtcAnalyticsCompression::Compress(ECtcAnalyticsCompression::Zstd, 3, Body, Compressed);
+		TestEqual(TEXT("Zstd is used"), static_cast<int32>(Method), static_cast<int32>(ECtcAnalyticsCompression::Zstd));
+
+		TArray<uint8> Decompressed;
+		Decompressed.SetNumUninitialized(Body.Num());
+		TestTrue(TEXT("Zstd decompresses"), FCompression::UncompressMemory(TEXT("Zstd"), Decompressed.GetData(), Decompressed.Num(), Compressed.GetData(), Compressed.Num()));
+		TestTrue(TEXT("Zstd decompresses to the original body"), Decompressed == Body);
+	}
+	else
+	{
+		TArray<uint8> Compressed;
+		const ECtcAnalyticsCompression Method = FCtcAnalyticsCompression::Compress(ECtcAnalyticsCompression::Zstd, 3, Body, Compressed);
+		TestEqual(TEXT("Zstd falls back to Gzip"), static_cast<int32>(Method), static_cast<int32>(ECtcAnalyticsCompression::Gzip));
+	}
+
+	// Bodies which don't get smaller are sent as they are
+	const uint8 TinyBody[] = {'[', ']'};
+	TArray<uint8> Compressed;
+	TestEqual(TEXT("Incompressible body is left alone"), static_cast<int32>(FCtcAnalyticsCompression::Compress(ECtcAnalyticsCompression::Gzip, 6, TinyBody, Compressed)), static_cast<int32>(ECtcAnalyticsCompression::None));
+	TestTrue(TEXT("Incompressible body has no compressed output"), Compressed.IsEmpty());
+
+	TestEqual(TEXT("Gzip content encoding"), FString(FCtcAnalyticsCompression::GetContentEncoding(ECtcAnalyticsCompression::Gzip)), FString(TEXT("gzip")));
+	TestEqual(TEXT("Zstd content encoding"), FString(FCtcAnalyticsCompression::GetContentEncoding(ECtcAnalyticsCompression::Zstd)), FString(TEXT("zstd")));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsCompressionContentEncodingTest, "CastToCloud.Analytics.Compression.ContentEncoding", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCtcAnalyticsCompressionContentEncodingTest::RunTest(const FString& Parameters)
+{
+	const TCHAR* const Route = TEXT("/events/compressed");
+
+	struct FReceivedRequest
+	{
+		FString ContentEncoding;
+		TArray<uint8> Body;
+	};
+	struct FFixture
+	{
+		FCtcAnalyticsOutbox Outbox{FPaths::AutomationTransientDir() / TEXT("CtcAnalyticsCompression")};
+		FCtcAnalyticsSendScheduler Scheduler{Outbox};
+		FCtcAnalyticsStandInEndpoint Endpoint;
+		TArray<FReceivedRequest> ReceivedRequests;
+	};
+	const TSharedRef<FFixture> Fixture = MakeShared<FFixture>();
+
+	// The stand-in keeps the bytes and the header exactly as they arrived, decoding happens once everything is in
+	Fixture->Endpoint.OnRequestReceived = [&ReceivedRequests = Fixture->ReceivedRequests](const FHttpServerRequest& Request)
+	{
+		FReceivedRequest& Received = ReceivedRequests.AddDefaulted_GetRef();
+		if (const TArray<FString>* ContentEncoding = Request.Headers.Find(TEXT("Content-Encoding")); ContentEncoding && !ContentEncoding->IsEmpty())
+		{
+			Received.ContentEncoding = (*ContentEncoding)[0];
+		}
+		Received.Body = Request.Body;
+	};
+	Fixture->Endpoint.Start(Route);
+
+	// The same body is sent as it is and compressed, the same way the flush pipeline hands the chunks to the scheduler
+	const TArray<uint8> Body = MakeRequestBody();
+	TArray<ECtcAnalyticsCompression> Methods = {ECtcAnalyticsCompression::None, ECtcAnalyticsCompression::Gzip};
+	if (FCompression::IsFormatValid(TEXT("Zstd")))
+	{
+		Methods.Add(ECtcAnalyticsCompression::Zstd);
+	}
+	for (const ECtcAnalyticsCompression Method : Methods)
+	{
+		FCtcAnalyticsOutboundRequest Request;
+		Request.Url = FCtcAnalyticsStandInEndpoint::GetUrl(Route);
+		Request.ContentEncoding = Method != ECtcAnalyticsCompression::None ? FCtcAnalyticsCompression::Compress(Method, 6, Body, Request.Body) : ECtcAnalyticsCompression::None;
+		if (Request.ContentEncoding == ECtcAnalyticsCompression::None)
+		{
+			Request.Body = Body;
+		}
+		Request.SegmentPath = Fixture->Outbox.Store(Request.Body, Request.ContentEncoding);
+		Fixture->Scheduler.Enqueue(MoveTemp(Request));
+	}
+
+	const double Deadline = FPlatformTime::Seconds() + 30.0;
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand(
+		[this, Fixture, Body, Methods, Deadline]()
+		{
+			const bool bSettled = Fixture->ReceivedRequests.Num() == Methods.Num() && Fixture->Scheduler.GetBacklogBytes() == 0;
+			if (!bSettled && FPlatformTime::Seconds() < Deadline)
+			{
+				return false;
+			}
+
+			TestTrue(TEXT("Every request reached the endpoint before the deadline"), bSettled);
+			for (const ECtcAnalyticsCompression Method : Methods)
+			{
+				const FString ContentEncoding = Method != ECtcAnalyticsCompression::None ? FCtcAnalyticsCompression::GetContentEncoding(Method) : TEXT("");
+				const FReceivedRequest* Received = Fixture->ReceivedRequests.FindByPredicate(
+					[&ContentEncoding](const FReceivedRequest& Request)
+					{
+						return Request.ContentEncoding == ContentEncoding;
+					}
+				);
+				const FString Label = ContentEncoding.IsEmpty() ? FString(TEXT("Uncompressed request")) : FString::Printf(TEXT("Request with Content-Encoding %s"), *ContentEncoding);
+				if (!TestNotNull(FString::Printf(TEXT("%s is received"), *Label), Received))
+				{
+					continue;
+				}
+
+				TArray<uint8> Decoded;
+				TestTrue(FString::Printf(TEXT("%s decodes"), *Label), DecodeBody(Received->ContentEncoding, Received->Body, Body.Num(), Decoded));
+				TestTrue(FString::Printf(TEXT("%s decodes to the original body"), *Label), Decoded == Body);
+			}
+
+			Fixture->Endpoint.Stop();
+			return true;
+		}
+	));
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,85 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include <Misc/AutomationTest.h>
+#include <Tasks/Task.h>
+
+#include "CtcAnalyticsEventQueue.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	struct FTestQueueElement : FCtcAnalyticsQueueNode
+	{
+		int32 Producer = 0;
+		int32 Index = 0;
+	};
+} // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsEventQueueMultipleProducersTest, "CastToCloud.Analytics.EventQueue.MultipleProducers", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCtcAnalyticsEventQueueMultipleProducersTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumProducers = 16;
+	constexpr int32 NumElementsPerProducer = 20000;
+
+	TArray<FTestQueueElement> Elements;
+	Elements.SetNum(NumProducers * NumElementsPerProducer);
+	TCtcAnalyticsEventQueue<FTestQueueElement> Queue;
+
+	std::atomic<int32> NumFinishedProducers = 0;
+	TArray<UE::Tasks::FTask> ProducerTasks;
+	for (int32 Producer = 0; Producer < NumProducers; ++Producer)
+	{
+		ProducerTasks.Add(UE::Tasks::Launch(
+			UE_SOURCE_LOCATION,
+			[&Elements, &Queue, &NumFinishedProducers, Producer]()
+			{
+				for (int32 Index = 0; Index < NumElementsPerProducer; ++Index)
+				{
+					FTestQueueElement& Element = Elements[Producer * NumElementsPerProducer + Index];
+					Element.Producer = Producer;
+					Element.Index = Index;
+					Queue.Enqueue(&Element);
+				}
+				NumFinishedProducers.fetch_add(1);
+			}
+		));
+	}
+
+	// The consumer drains while the producers are still enqueueing, the same way a flush runs while events are recorded
+	TArray<int32> NextIndices;
+	NextIndices.SetNumZeroed(NumProducers);
+	int32 NumDequeued = 0;
+	bool bInOrder = true;
+	for (;;)
+	{
+		// NOTE: Read before draining, once every producer is done nothing is left half linked and the drain empties the queue
+		const bool bProducersFinished = NumFinishedProducers.load() == NumProducers;
+		while (FTestQueueElement* Element = Queue.Dequeue())
+		{
+			bInOrder &= Element->Index == NextIndices[Element->Producer];
+			NextIndices[Element->Producer] = Element->Index + 1;
+			++NumDequeued;
+		}
+
+		if (bProducersFinished)
+		{
+			break;
+		}
+		FPlatformProcess::Yield();
+	}
+	UE::Tasks::Wait(ProducerTasks);
+
+	TestEqual(TEXT("Every element is dequeued"), NumDequeued, NumProducers * NumElementsPerProducer);
+	TestTrue(TEXT("Elements of a producer are dequeued once and in order"), bInOrder);
+	for (int32 Producer = 0; Producer < NumProducers; ++Producer)
+	{
+		TestEqual(FString::Printf(TEXT("Last element of producer %d"), Producer), NextIndices[Producer], NumElementsPerProducer);
+	}
+	TestTrue(TEXT("The queue is empty"), Queue.IsEmpty());
+
+	return true;
+}
+
+#endif
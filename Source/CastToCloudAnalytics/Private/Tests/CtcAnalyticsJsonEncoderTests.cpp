@@ -0,0 +1,232 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include <Dom/JsonObject.h>
+#include <Misc/AutomationTest.h>
+#include <Policies/CondensedJsonPrintPolicy.h>
+#include <Serialization/JsonSerializer.h>
+#include <Serialization/JsonWriter.h>
+
+#include "CtcAnalyticsJsonEncoder.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	using FCondensedJsonWriter = TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>;
+	using FCondensedJsonWriterFactory = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>;
+
+	/**
+	 * Strings covering every escaping rule: quotes, backslashes, control characters, non-ASCII and surrogate pairs
+	 */
+	const TCHAR* const TrickyStrings[] = {
+		TEXT(""),
+		TEXT("plain"),
+		TEXT("\"quoted\" back\\slash /slash"),
+		TEXT("line\nfeed\ttab\rreturn\bbackspace\fform feed"),
+		TEXT("\x01\x1F control"),
+		TEXT("caf\u00e9 \u20ac \u4e2d\u6587"),
+		TEXT("emoji \U0001F600 end"),
+	};
+
+	TArray<uint8> ToUtf8(const FString& String)
+	{
+		const FTCHARToUTF8 Utf8(*String, String.Len());
+		return TArray<uint8>(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	}
+
+	FString FromUtf8(TConstArrayView<uint8> Bytes)
+	{
+		const FUTF8ToTCHAR Chars(reinterpret_cast<const ANSICHAR*>(Bytes.GetData()), Bytes.Num());
+		return FString(Chars.Length(), Chars.Get());
+	}
+
+	/**
+	 * Compares the bytes, reporting both sides as text when they differ
+	 */
+	void TestSameBytes(FAutomationTestBase& Test, const FString& What, TConstArrayView<uint8> Actual, TConstArrayView<uint8> Expected)
+	{
+		if (Actual.Num() != Expected.Num() || FMemory::Memcmp(Actual.GetData(), Expected.GetData(), Actual.Num()) != 0)
+		{
+			Test.AddError(FString::Printf(TEXT("%s: expected %s but got %s."), *What, *FromUtf8(Expected), *FromUtf8(Actual)));
+		}
+	}
+
+	/**
+	 * Event shaped like the ones sent to the backend, written by the DOM based serializer the encoder replaced
+	 */
+	TSharedRef<FJsonObject> MakeDomEvent(int32 Index)
+	{
+		TSharedRef<FJsonObject> EventProperties = MakeShared<FJsonObject>();
+		EventProperties->SetStringField(TEXT("build_configuration"), TEXT("Development"));
+		EventProperties->SetStringField(TEXT("project_version"), TEXT("1.0.0.0"));
+		EventProperties->SetStringField(TEXT("weapon"), TrickyStrings[Index % UE_ARRAY_COUNT(TrickyStrings)]);
+		EventProperties->SetStringField(TEXT("damage"), LexToString(Index * 1.5));
+
+		TSharedRef<FJsonObject> UserProperties = MakeShared<FJsonObject>();
+		UserProperties->SetStringField(TEXT("device"), TEXT("Windows"));
+		UserProperties->SetStringField(TEXT("gpu.device"), TEXT("NVIDIA GeForce RTX 4090"));
+
+		TSharedRef<FJsonObject> Event = MakeShared<FJsonObject>();
+		Event->SetStringField(TEXT("event_name"), TEXT("Hit"));
+		Event->SetStringField(TEXT("created_at"), FDateTime(2026, 1, 2, 3, 4, 5, Index % 1000).ToIso8601());
+		Event->SetStringField(TEXT("session_id"), TEXT("5C4B2C8F4E1B4A6F9D0E3F2A1B0C9D8E"));
+		Event->SetStringField(TEXT("user_id"), TEXT("0123456789ABCDEF"));
+		Event->SetObjectField(TEXT("event_properties"), EventProperties);
+		Event->SetObjectField(TEXT("user_properties"), UserProperties);
+		Event->SetStringField(TEXT("world"), TEXT("/Game/Maps/Arena"));
+		Event->SetNumberField(TEXT("position_x"), Index * 100.25);
+		Event->SetNumberField(TEXT("position_y"), -Index / 3.0);
+		Event->SetNumberField(TEXT("position_z"), 0.1);
+		return Event;
+	}
+
+	/**
+	 * Same event as MakeDomEvent, written by the streaming encoder
+	 */
+	void EncodeEvent(FCtcAnalyticsJsonEncoder& Encoder, int32 Index)
+	{
+		Encoder.BeginObject();
+		Encoder.WriteStringField(TEXT("event_name"), TEXT("Hit"));
+		Encoder.WriteKey(TEXT("created_at"));
+		Encoder.WriteDateTime(FDateTime(2026, 1, 2, 3, 4, 5, Index % 1000), false);
+		Encoder.WriteStringField(TEXT("session_id"), TEXT("5C4B2C8F4E1B4A6F9D0E3F2A1B0C9D8E"));
+		Encoder.WriteStringField(TEXT("user_id"), TEXT("0123456789ABCDEF"));
+
+		Encoder.WriteKey(TEXT("event_properties"));
+		Encoder.BeginObject();
+		Encoder.WriteStringField(TEXT("build_configuration"), TEXT("Development"));
+		Encoder.WriteStringField(TEXT("project_version"), TEXT("1.0.0.0"));
+		Encoder.WriteStringField(TEXT("weapon"), TrickyStrings[Index % UE_ARRAY_COUNT(TrickyStrings)]);
+		Encoder.WriteStringField(TEXT("damage"), LexToString(Index * 1.5));
+		Encoder.EndObject();
+
+		Encoder.WriteKey(TEXT("user_properties"));
+		Encoder.BeginObject();
+		Encoder.WriteStringField(TEXT("device"), TEXT("Windows"));
+		Encoder.WriteStringField(TEXT("gpu.device"), TEXT("NVIDIA GeForce RTX 4090"));
+		Encoder.EndObject();
+
+		Encoder.WriteStringField(TEXT("world"), TEXT("/Game/Maps/Arena"));
+		Encoder.WriteNumberField(TEXT("position_x"), Index * 100.25);
+		Encoder.WriteNumberField(TEXT("position_y"), -Index / 3.0);
+		Encoder.WriteNumberField(TEXT("position_z"), 0.1);
+		Encoder.EndObject();
+	}
+
+	/**
+	 * Request body the way the DOM based serializer built it, converted to UTF-8 like it was before being sent
+	 */
+	TArray<uint8> SerializeDomBatch(int32 NumEvents)
+	{
+		TArray<TSharedPtr<FJsonValue>> EventsArray;
+		EventsArray.Reserve(NumEvents);
+		for (int32 Index = 0; Index < NumEvents; ++Index)
+		{
+			EventsArray.Add(MakeShared<FJsonValueObject>(MakeDomEvent(Index)));
+		}
+
+		TSharedRef<FJsonObject> Body = MakeShared<FJsonObject>();
+		Body->SetArrayField(TEXT("eventsPayload"), EventsArray);
+		Body->SetBoolField(TEXT("geoTracking"), true);
+
+		FString BodyString;
+		const TSharedRef<FCondensedJsonWriter> Writer = FCondensedJsonWriterFactory::Create(&BodyString);
+		FJsonSerializer::Serialize(Body, Writer);
+		return ToUtf8(BodyString);
+	}
+
+	void EncodeBatch(int32 NumEvents, TArray<uint8>& OutBody)
+	{
+		OutBody.Reset();
+		FCtcAnalyticsJsonEncoder Encoder(OutBody);
+		Encoder.BeginObject();
+		Encoder.WriteKey(TEXT("eventsPayload"));
+		Encoder.BeginArray();
+		for (int32 Index = 0; Index < NumEvents; ++Index)
+		{
+			EncodeEvent(Encoder, Index);
+		}
+		Encoder.EndArray();
+		Encoder.WriteBoolField(TEXT("geoTracking"), true);
+		Encoder.EndObject();
+	}
+} // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsJsonEncoderGoldenTest, "CastToCloud.Analytics.JsonEncoder.MatchesJsonWriter", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCtcAnalyticsJsonEncoderGoldenTest::RunTest(const FString& Parameters)
+{
+	for (const TCHAR* String : TrickyStrings)
+	{
+		FString Expected;
+		const TSharedRef<FCondensedJsonWriter> Writer = FCondensedJsonWriterFactory::Create(&Expected);
+		Writer->WriteArrayStart();
+		Writer->WriteValue(FString(String));
+		Writer->WriteArrayEnd();
+		Writer->Close();
+
+		TArray<uint8> Actual;
+		FCtcAnalyticsJsonEncoder Encoder(Actual);
+		Encoder.BeginArray();
+		Encoder.WriteString(String);
+		Encoder.EndArray();
+
+		TestSameBytes(*this, FString::Printf(TEXT("Escaped string %s"), *Expected), Actual, ToUtf8(Expected));
+	}
+
+	for (const double Number : {0.0, -0.0, 1.0, -12.5, 0.1, 1.0 / 3.0, 1e21, 1.7976931348623157e308, 4.9e-324})
+	{
+		FString Expected;
+		const TSharedRef<FCondensedJsonWriter> Writer = FCondensedJsonWriterFactory::Create(&Expected);
+		Writer->WriteArrayStart();
+		Writer->WriteValue(Number);
+		Writer->WriteArrayEnd();
+		Writer->Close();
+
+		TArray<uint8> Actual;
+		FCtcAnalyticsJsonEncoder Encoder(Actual);
+		Encoder.BeginArray();
+		Encoder.WriteNumber(Number);
+		Encoder.EndArray();
+
+		TestSameBytes(*this, FString::Printf(TEXT("Number %s"), *Expected), Actual, ToUtf8(Expected));
+	}
+
+	// A whole request, every event of the batch goes through a different escaping rule
+	TArray<uint8> Actual;
+	EncodeBatch(UE_ARRAY_COUNT(TrickyStrings) * 2, Actual);
+	TestSameBytes(*this, TEXT("Request body"), Actual, SerializeDomBatch(UE_ARRAY_COUNT(TrickyStrings) * 2));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsJsonEncoderBenchmark, "CastToCloud.Analytics.JsonEncoder.Benchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FCtcAnalyticsJsonEncoderBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumEvents = 10000;
+	constexpr int32 NumRuns = 5;
+
+	// NOTE: The encoder reuses its buffer between batches like the flush does, the DOM path starts over every time
+	TArray<uint8> EncodedBody;
+	double BestEncoderTime = MAX_dbl;
+	double BestDomTime = MAX_dbl;
+	for (int32 Run = 0; Run < NumRuns; ++Run)
+	{
+		double StartTime = FPlatformTime::Seconds();
+		EncodeBatch(NumEvents, EncodedBody);
+		BestEncoderTime = FMath::Min(BestEncoderTime, FPlatformTime::Seconds() - StartTime);
+
+		StartTime = FPlatformTime::Seconds();
+		const TArray<uint8> DomBody = SerializeDomBatch(NumEvents);
+		BestDomTime = FMath::Min(BestDomTime, FPlatformTime::Seconds() - StartTime);
+
+		TestSameBytes(*this, TEXT("Both paths produce the same body"), EncodedBody, DomBody);
+	}
+
+	AddInfo(FString::Printf(TEXT("%d events, %d bytes. DOM: %.2fms, encoder: %.2fms (%.1fx faster)."), NumEvents, EncodedBody.Num(), BestDomTime * 1000.0, BestEncoderTime * 1000.0, BestDomTime / FMath::Max(BestEncoderTime, UE_DOUBLE_SMALL_NUMBER)));
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,65 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include <HAL/FileManager.h>
+#include <Misc/AutomationTest.h>
+#include <Misc/Paths.h>
+
+#include "CtcAnalyticsOutbox.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsOutboxLimitsTest, "CastToCloud.Analytics.Outbox.Limits", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCtcAnalyticsOutboxLimitsTest::RunTest(const FString& Parameters)
+{
+	const FString Directory = FPaths::AutomationTransientDir() / TEXT("CtcAnalyticsOutboxLimits");
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+	TArray<uint8> Body;
+	Body.SetNumZeroed(1000);
+
+	// A previous run left a segment older than the cutoff and a recent one
+	FString ExpiredPath;
+	FString RecentPath;
+	{
+		FCtcAnalyticsOutbox PreviousRun(Directory);
+		ExpiredPath = PreviousRun.Store(Body, ECtcAnalyticsCompression::None);
+		RecentPath = PreviousRun.Store(Body, ECtcAnalyticsCompression::None);
+	}
+	IFileManager::Get().SetTimeStamp(*ExpiredPath, FDateTime::UtcNow() - FTimespan::FromDays(30.0));
+
+	// NOTE: Every segment takes its body and a few bytes of header, three of them don't fit
+	FCtcAnalyticsOutbox Outbox(Directory);
+	Outbox.SetLimits(3500, FTimespan::FromDays(7.0).GetTotalSeconds());
+
+	const TArray<FString> RecoveredSegments = Outbox.TakeRecoveredSegments();
+	TestEqual(TEXT("Only the recent segment is recovered"), RecoveredSegments.Num(), 1);
+	TestTrue(TEXT("The recent segment is recovered"), RecoveredSegments.Contains(RecentPath));
+	TestFalse(TEXT("The expired segment is deleted"), FPaths::FileExists(ExpiredPath));
+
+	TArray<FString> StoredPaths;
+	for (int32 Index = 0; Index < 3; ++Index)
+	{
+		StoredPaths.Add(Outbox.Store(Body, ECtcAnalyticsCompression::None));
+	}
+	TestFalse(TEXT("The recovered segment is evicted first"), FPaths::FileExists(RecentPath));
+	for (const FString& StoredPath : StoredPaths)
+	{
+		TestTrue(FString::Printf(TEXT("Segment %s is kept"), *StoredPath), FPaths::FileExists(StoredPath));
+	}
+
+	// Removed segments give their room back
+	Outbox.Remove(StoredPaths[0]);
+	StoredPaths.Add(Outbox.Store(Body, ECtcAnalyticsCompression::None));
+	TestTrue(TEXT("A segment fitting in the room of a removed one evicts nothing"), FPaths::FileExists(StoredPaths[1]));
+
+	StoredPaths.Add(Outbox.Store(Body, ECtcAnalyticsCompression::None));
+	TestFalse(TEXT("The oldest segment of the run is evicted"), FPaths::FileExists(StoredPaths[1]));
+	TestTrue(TEXT("The newest segment is kept"), FPaths::FileExists(StoredPaths.Last()));
+
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,75 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <AnalyticsEventAttribute.h>
+
+#include "CtcAnalyticsProvider.h"
+
+/**
+ * Reaches the private parts of the provider the tests and benchmarks measure
+ */
+struct FCtcAnalyticsProviderTestAccess
+{
+	/**
+	 * Memory an event recorded through RecordEvent takes in the event arena, interning into the provider's tables
+	 */
+	static int32 GetCachedEventSize(FCtcAnalyticsProvider& Provider, FStringView EventName, TConstArrayView<FAnalyticsEventAttribute> Attributes)
+	{
+		using FCachedAttribute = FCtcAnalyticsProvider::FCachedAttribute;
+
+		TArray<FCachedAttribute> CachedAttributes;
+		for (const FAnalyticsEventAttribute& Attribute : Attributes)
+		{
+			CachedAttributes.Add(FCachedAttribute::MakeString(Provider.AttributeKeys.Intern(Attribute.GetName()), Attribute.GetName(), Attribute.GetValue()));
+		}
+
+		FCtcAnalyticsProvider::FCachedEvent Event;
+		Event.NameId = Provider.EventNames.Intern(EventName);
+		Event.Name = Event.NameId == INDEX_NONE ? EventName : FStringView();
+		Event.Attributes = CachedAttributes;
+		return FCtcAnalyticsProvider::GetEventMemorySize(Event);
+	}
+
+	/**
+	 * Lets a provider record events without it being the active one nor having a session started by the engine
+	 */
+	static void StartRecording(FCtcAnalyticsProvider& Provider)
+	{
+		Provider.AcceptState.store(FCtcAnalyticsProvider::EAcceptState::Accepting, std::memory_order_relaxed);
+		Provider.State = FCtcAnalyticsProvider::ESessionState::Started;
+	}
+
+	/**
+	 * Consumes the pending events the way a flush does, without sending them
+	 */
+	static void DropPendingEvents(FCtcAnalyticsProvider& Provider)
+	{
+		Provider.SnapshotPendingEvents(Provider.GetBatchContext());
+	}
+
+	/**
+	 * Runs the snapshot and serialization stages of a flush, without sending the batch
+	 * @return Number of events in the batch
+	 */
+	static int32 FlushPendingEvents(FCtcAnalyticsProvider& Provider)
+	{
+		const TSharedRef<FCtcAnalyticsProvider::FBatch> Batch = Provider.SnapshotPendingEvents(Provider.GetBatchContext());
+		Provider.SerializeBatch(*Batch);
+		return Batch->Events.Num();
+	}
+
+	/**
+	 * Sends the provider's batches to the backend at EventsUrl, whatever the command line and the settings say
+	 */
+	static void SendTo(FCtcAnalyticsProvider& Provider, const FString& EventsUrl)
+	{
+		Provider.SendPolicy.Destination = FCtcAnalyticsProvider::EBatchDestination::Backend;
+		Provider.SendPolicy.EventsUrl = EventsUrl;
+		Provider.BatchContext.Reset();
+	}
+
+	static void FlushForShutdown(FCtcAnalyticsProvider& Provider) { Provider.FlushForShutdown(); }
+	static int32 GetNumPendingEvents(const FCtcAnalyticsProvider& Provider) { return Provider.NumPendingEvents.load(std::memory_order_relaxed); }
+	static int64 GetPendingEventsMemory(const FCtcAnalyticsProvider& Provider) { return Provider.PendingEventsMemory.load(std::memory_order_relaxed); }
+};
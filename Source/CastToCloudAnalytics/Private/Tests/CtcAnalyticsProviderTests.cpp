@@ -0,0 +1,192 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include <AnalyticsEventAttribute.h>
+#include <HAL/FileManager.h>
+#include <Misc/AutomationTest.h>
+#include <Misc/Paths.h>
+#include <Tasks/Task.h>
+
+#include "CtcAnalyticsProvider.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CtcAnalyticsProviderTestAccess.h"
+#include "CtcAnalyticsStandInEndpoint.h"
+
+namespace
+{
+	/**
+	 * Layout of the cached events before names and keys were interned, every event owned copies of all its strings
+	 */
+	struct FLegacyCachedEvent
+	{
+		FString Name;
+		FDateTime Timestamp;
+		FString World;
+		TOptional<FTransform> Transform;
+		TArray<FAnalyticsEventAttribute> Attributes;
+
+		SIZE_T GetMemorySize() const
+		{
+			SIZE_T Size = sizeof(FLegacyCachedEvent) + Name.GetAllocatedSize() + World.GetAllocatedSize() + Attributes.GetAllocatedSize();
+			for (const FAnalyticsEventAttribute& Attribute : Attributes)
+			{
+				Size += Attribute.GetName().GetAllocatedSize() + Attribute.GetValue().GetAllocatedSize();
+			}
+			return Size;
+		}
+	};
+
+	/**
+	 * Events shaped like a game's, a few dozen names and keys repeating across all of them
+	 */
+	TArray<FAnalyticsEventAttribute> MakeAttributes(int32 Index)
+	{
+		constexpr int32 NumKeys = 50;
+		constexpr int32 NumAttributes = 6;
+
+		TArray<FAnalyticsEventAttribute> Attributes;
+		for (int32 AttributeIndex = 0; AttributeIndex < NumAttributes; ++AttributeIndex)
+		{
+			const int32 Key = (Index * 7 + AttributeIndex * 13) % NumKeys;
+			Attributes.Emplace(FString::Printf(TEXT("benchmark_attribute_%02d"), Key), LexToString((Index * 31 + AttributeIndex) % 5000));
+		}
+		return Attributes;
+	}
+
+	FString MakeEventName(int32 Index)
+	{
+		constexpr int32 NumEventNames = 30;
+
+		return FString::Printf(TEXT("BenchmarkEvent%02d"), Index % NumEventNames);
+	}
+} // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsProviderConcurrentRecordingTest, "CastToCloud.Analytics.Provider.ConcurrentRecording", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCtcAnalyticsProviderConcurrentRecordingTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumProducers = 16;
+	constexpr int32 NumEventsPerProducer = 5000;
+
+	FCtcAnalyticsProvider Provider(FPaths::AutomationTransientDir() / TEXT("CtcAnalyticsProvider"));
+	FCtcAnalyticsProviderTestAccess::StartRecording(Provider);
+
+	std::atomic<int32> NumFinishedProducers = 0;
+	TArray<UE::Tasks::FTask> ProducerTasks;
+	for (int32 Producer = 0; Producer < NumProducers; ++Producer)
+	{
+		ProducerTasks.Add(UE::Tasks::Launch(
+			UE_SOURCE_LOCATION,
+			[&Provider, &NumFinishedProducers, Producer]()
+			{
+				for (int32 Index = 0; Index < NumEventsPerProducer; ++Index)
+				{
+					const FAnalyticsEventAttribute Attributes[] = {FAnalyticsEventAttribute(TEXT("producer"), Producer), FAnalyticsEventAttribute(TEXT("index"), Index)};
+					Provider.RecordEvent(FStringView(TEXT("ConcurrentRecording")), Attributes);
+				}
+				NumFinishedProducers.fetch_add(1);
+			}
+		));
+	}
+
+	// Flushes rotate the arenas and drain the queue while the producers are still recording, the same way the flush timer does
+	int32 NumFlushes = 0;
+	int32 NumFlushedEvents = 0;
+	for (;;)
+	{
+		// NOTE: Read before flushing, once every producer is done the flush drains everything they recorded
+		const bool bProducersFinished = NumFinishedProducers.load() == NumProducers;
+		NumFlushedEvents += FCtcAnalyticsProviderTestAccess::FlushPendingEvents(Provider);
+		++NumFlushes;
+
+		if (bProducersFinished)
+		{
+			break;
+		}
+		FPlatformProcess::Sleep(0.001f);
+	}
+	UE::Tasks::Wait(ProducerTasks);
+
+	AddInfo(FString::Printf(TEXT("%d events recorded by %d producers, drained by %d flushes."), NumFlushedEvents, NumProducers, NumFlushes));
+	TestEqual(TEXT("Every recorded event is flushed once"), NumFlushedEvents, NumProducers * NumEventsPerProducer);
+	TestEqual(TEXT("No event is left pending"), FCtcAnalyticsProviderTestAccess::GetNumPendingEvents(Provider), 0);
+	TestEqual(TEXT("No memory is left pending"), FCtcAnalyticsProviderTestAccess::GetPendingEventsMemory(Provider), int64(0));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsProviderShutdownDeadlineTest, "CastToCloud.Analytics.Provider.ShutdownDeadline", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCtcAnalyticsProviderShutdownDeadlineTest::RunTest(const FString& Parameters)
+{
+	// NOTE: Generous enough for a loaded build machine, a flush waiting for the HTTP timeout would take far longer
+	constexpr float Timeout = 0.5f;
+	constexpr double AllowedOverrun = 0.25;
+	const TCHAR* const BlackholeRoute = TEXT("/events/shutdown");
+
+	UCtcSharedSettings* Settings = GetMutableDefault<UCtcSharedSettings>();
+	const float PreviousShutdownFlushTimeout = Settings->ShutdownFlushTimeout;
+	Settings->ShutdownFlushTimeout = Timeout;
+
+	FCtcAnalyticsStandInEndpoint Endpoint;
+	Endpoint.UnscriptedCode = 0;
+	Endpoint.Start(BlackholeRoute);
+
+	const FString StorageDir = FPaths::AutomationTransientDir() / TEXT("CtcAnalyticsProviderShutdown");
+	{
+		FCtcAnalyticsProvider Provider(StorageDir);
+		FCtcAnalyticsProviderTestAccess::StartRecording(Provider);
+		FCtcAnalyticsProviderTestAccess::SendTo(Provider, FCtcAnalyticsStandInEndpoint::GetUrl(BlackholeRoute));
+
+		for (int32 Index = 0; Index < 100; ++Index)
+		{
+			Provider.RecordEvent(MakeEventName(Index), MakeAttributes(Index));
+		}
+
+		FCtcAnalyticsProviderTestAccess::FlushForShutdown(Provider);
+
+		const double FlushDuration = Provider.GetLastShutdownFlushDuration();
+		AddInfo(FString::Printf(TEXT("FlushForShutdown returned after %.1fms with a %.1fms deadline."), FlushDuration * 1000.0, Timeout * 1000.0));
+		TestTrue(TEXT("FlushForShutdown honors ShutdownFlushTimeout"), FlushDuration < Timeout + AllowedOverrun);
+		TestEqual(TEXT("Every event was taken by the flush"), FCtcAnalyticsProviderTestAccess::GetNumPendingEvents(Provider), 0);
+	}
+
+	Endpoint.Stop();
+	Settings->ShutdownFlushTimeout = PreviousShutdownFlushTimeout;
+	IFileManager::Get().DeleteDirectory(*StorageDir, false, true);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsProviderEventMemoryBenchmark, "CastToCloud.Analytics.Provider.EventMemoryBenchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FCtcAnalyticsProviderEventMemoryBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumEvents = 10000;
+
+	FCtcAnalyticsProvider Provider(FPaths::AutomationTransientDir() / TEXT("CtcAnalyticsProvider"));
+
+	SIZE_T LegacySize = 0;
+	SIZE_T CachedSize = 0;
+	for (int32 Index = 0; Index < NumEvents; ++Index)
+	{
+		FLegacyCachedEvent LegacyEvent;
+		LegacyEvent.Name = MakeEventName(Index);
+		LegacyEvent.World = TEXT("/Game/Maps/Arena");
+		LegacyEvent.Attributes = MakeAttributes(Index);
+		LegacySize += LegacyEvent.GetMemorySize();
+
+		CachedSize += FCtcAnalyticsProviderTestAccess::GetCachedEventSize(Provider, LegacyEvent.Name, LegacyEvent.Attributes);
+	}
+
+	// NOTE: Allocator overhead isn't counted on either side, the legacy layout made three allocations plus two per attribute
+	const double LegacyBytesPerEvent = static_cast<double>(LegacySize) / NumEvents;
+	const double CachedBytesPerEvent = static_cast<double>(CachedSize) / NumEvents;
+	AddInfo(FString::Printf(TEXT("%d events. Owned strings: %.1f bytes per event, interned names: %.1f bytes per event (%.1fx smaller)."), NumEvents, LegacyBytesPerEvent, CachedBytesPerEvent, LegacyBytesPerEvent / FMath::Max(CachedBytesPerEvent, 1.0)));
+	TestTrue(TEXT("Interned events take less memory"), CachedBytesPerEvent < LegacyBytesPerEvent);
+
+	return true;
+}
+
+#endif
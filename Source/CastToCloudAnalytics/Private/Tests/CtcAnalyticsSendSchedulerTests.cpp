@@ -0,0 +1,157 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#include <HAL/FileManager.h>
+#include <Misc/AutomationTest.h>
+#include <Misc/Paths.h>
+
+#include "CtcAnalyticsOutbox.h"
+#include "CtcAnalyticsSendScheduler.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CtcAnalyticsStandInEndpoint.h"
+
+namespace
+{
+	const TCHAR* const StandInRoute = TEXT("/events/record");
+	const TCHAR* const BlackholeRoute = TEXT("/events/blackhole");
+
+	struct FSchedulerFixture
+	{
+		FCtcAnalyticsOutbox Outbox{FPaths::AutomationTransientDir() / TEXT("CtcAnalyticsSendScheduler")};
+		FCtcAnalyticsSendScheduler Scheduler{Outbox};
+		FCtcAnalyticsStandInEndpoint Endpoint;
+	};
+
+	TArray<uint8> ToBody(const TCHAR* Json)
+	{
+		const FTCHARToUTF8 Utf8(Json);
+		return TArray<uint8>(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	}
+} // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsSendSchedulerScriptedFailuresTest, "CastToCloud.Analytics.SendScheduler.ScriptedFailures", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCtcAnalyticsSendSchedulerScriptedFailuresTest::RunTest(const FString& Parameters)
+{
+	UCtcSharedSettings* Settings = GetMutableDefault<UCtcSharedSettings>();
+	const int32 PreviousMaxSendAttempts = Settings->MaxSendAttempts;
+	Settings->MaxSendAttempts = 5;
+
+	const TSharedRef<FSchedulerFixture> Fixture = MakeShared<FSchedulerFixture>();
+
+	// Retried until it goes through, a permanent failure, and a request recovered from the outbox which is loaded in the background
+	const TCHAR* const RetriedBody = TEXT("{\"eventsPayload\":[\"retried\"]}");
+	const TCHAR* const RejectedBody = TEXT("{\"eventsPayload\":[\"rejected\"]}");
+	const TCHAR* const RecoveredBody = TEXT("{\"eventsPayload\":[\"recovered\"]}");
+	Fixture->Endpoint.Scripts.Add(RetriedBody, {503, 429, 500, 200});
+	Fixture->Endpoint.Scripts.Add(RejectedBody, {400});
+	Fixture->Endpoint.Scripts.Add(RecoveredBody, {503, 200});
+	Fixture->Endpoint.Start(StandInRoute);
+
+	const FString Url = FCtcAnalyticsStandInEndpoint::GetUrl(StandInRoute);
+	TArray<FString> SegmentPaths;
+	for (const TCHAR* Body : {RetriedBody, RejectedBody, RecoveredBody})
+	{
+		FCtcAnalyticsOutboundRequest Request;
+		Request.Url = Url;
+		Request.Body = ToBody(Body);
+		Request.SegmentPath = Fixture->Outbox.Store(Request.Body, ECtcAnalyticsCompression::None);
+		SegmentPaths.Add(Request.SegmentPath);
+
+		if (Body == RecoveredBody)
+		{
+			Request.Body.Empty();
+		}
+		else
+		{
+			Request.SessionID = TEXT("ScriptedFailures");
+			Request.Sequence = Body == RetriedBody ? 0 : 1;
+		}
+
+		Fixture->Scheduler.Enqueue(MoveTemp(Request));
+	}
+
+	const double Deadline = FPlatformTime::Seconds() + 30.0;
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand(
+		[this, Fixture, SegmentPaths, Settings, PreviousMaxSendAttempts, Deadline, RetriedBody, RejectedBody, RecoveredBody]()
+		{
+			const bool bSettled = Fixture->Scheduler.GetAcknowledgedSequence(TEXT("ScriptedFailures")) == 1 && !FPaths::FileExists(SegmentPaths[2]);
+			if (!bSettled && FPlatformTime::Seconds() < Deadline)
+			{
+				return false;
+			}
+
+			TestTrue(TEXT("Every request settled before the deadline"), bSettled);
+			TestEqual(TEXT("Retried request attempts"), Fixture->Endpoint.NumReceived.FindRef(RetriedBody), 4);
+			TestEqual(TEXT("Rejected request attempts"), Fixture->Endpoint.NumReceived.FindRef(RejectedBody), 1);
+			TestEqual(TEXT("Recovered request attempts"), Fixture->Endpoint.NumReceived.FindRef(RecoveredBody), 2);
+			for (const FString& SegmentPath : SegmentPaths)
+			{
+				TestFalse(FString::Printf(TEXT("Outbox segment %s is removed"), *SegmentPath), FPaths::FileExists(SegmentPath));
+			}
+			TestEqual(TEXT("Nothing is left in the backlog"), Fixture->Scheduler.GetBacklogBytes(), int64(0));
+
+			Fixture->Endpoint.Stop();
+			Settings->MaxSendAttempts = PreviousMaxSendAttempts;
+			return true;
+		}
+	));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCtcAnalyticsSendSchedulerShutdownDeadlineTest, "CastToCloud.Analytics.SendScheduler.ShutdownDeadline", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCtcAnalyticsSendSchedulerShutdownDeadlineTest::RunTest(const FString& Parameters)
+{
+	// NOTE: Generous enough for a loaded build machine, a flush waiting for the HTTP timeout would take far longer
+	constexpr double Timeout = 0.5;
+	constexpr double AllowedOverrun = 0.25;
+
+	const TCHAR* const Body = TEXT("{\"eventsPayload\":[\"blackholed\"]}");
+	TUniquePtr<FSchedulerFixture> Fixture = MakeUnique<FSchedulerFixture>();
+	Fixture->Endpoint.Scripts.Add(Body, {0, 0});
+	Fixture->Endpoint.Start(BlackholeRoute);
+
+	auto MakeRequest = [&Fixture, Body]()
+	{
+		FCtcAnalyticsOutboundRequest Request;
+		Request.Url = FCtcAnalyticsStandInEndpoint::GetUrl(BlackholeRoute);
+		Request.Body = ToBody(Body);
+		Request.SegmentPath = Fixture->Outbox.Store(Request.Body, ECtcAnalyticsCompression::None);
+		return Request;
+	};
+
+	// The final flush sends the last batch itself and gives up at the deadline
+	FCtcAnalyticsOutboundRequest SentRequest = MakeRequest();
+	const FString SentSegmentPath = SentRequest.SegmentPath;
+	double StartTime = FPlatformTime::Seconds();
+	Fixture->Scheduler.SendAndWait(MoveTemp(SentRequest), StartTime + Timeout);
+	const double SendDuration = FPlatformTime::Seconds() - StartTime;
+	AddInfo(FString::Printf(TEXT("SendAndWait returned after %.1fms with a %.1fms deadline."), SendDuration * 1000.0, Timeout * 1000.0));
+	TestTrue(TEXT("SendAndWait honors its deadline"), SendDuration < Timeout + AllowedOverrun);
+	TestTrue(TEXT("The unsent batch stays in the outbox"), FPaths::FileExists(SentSegmentPath));
+
+	// Then waits for the batches already in flight, up to the same kind of deadline
+	FCtcAnalyticsOutboundRequest QueuedRequest = MakeRequest();
+	const FString QueuedSegmentPath = QueuedRequest.SegmentPath;
+	Fixture->Scheduler.Enqueue(MoveTemp(QueuedRequest));
+	StartTime = FPlatformTime::Seconds();
+	Fixture->Scheduler.WaitForInFlightRequests(StartTime + Timeout);
+	const double WaitDuration = FPlatformTime::Seconds() - StartTime;
+	AddInfo(FString::Printf(TEXT("WaitForInFlightRequests returned after %.1fms with a %.1fms deadline."), WaitDuration * 1000.0, Timeout * 1000.0));
+	TestTrue(TEXT("WaitForInFlightRequests honors its deadline"), WaitDuration < Timeout + AllowedOverrun);
+
+	// NOTE: Destroying the scheduler cancels the request still in flight, its segment is kept for the next launch
+	Fixture->Endpoint.Stop();
+	Fixture.Reset();
+	TestTrue(TEXT("The cancelled batch stays in the outbox"), FPaths::FileExists(QueuedSegmentPath));
+
+	IFileManager::Get().Delete(*SentSegmentPath);
+	IFileManager::Get().Delete(*QueuedSegmentPath);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,81 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <HttpPath.h>
+#include <HttpServerModule.h>
+#include <HttpServerRequest.h>
+#include <HttpServerResponse.h>
+#include <IHttpRouter.h>
+
+/**
+ * Local stand-in for the events endpoint, used by the automation tests. Answers every body with the status codes scripted
+ * for it, in order. A 0 in the script never answers, like a blackholed network
+ */
+struct FCtcAnalyticsStandInEndpoint
+{
+	static constexpr uint32 Port = 18917;
+
+	TMap<FString, TArray<int32>> Scripts;
+	/**
+	 * Status code answered to the bodies without a script
+	 */
+	int32 UnscriptedCode = 200;
+	TMap<FString, int32> NumReceived;
+	/**
+	 * Called with every request received, before it's answered
+	 */
+	TFunction<void(const FHttpServerRequest&)> OnRequestReceived;
+	TSharedPtr<IHttpRouter> Router;
+	FHttpRouteHandle RouteHandle;
+
+	static FString GetUrl(const TCHAR* Route)
+	{
+		return FString::Printf(TEXT("http://127.0.0.1:%u%s"), Port, Route);
+	}
+
+	void Start(const TCHAR* Route)
+	{
+		Router = FHttpServerModule::Get().GetHttpRouter(Port);
+		RouteHandle = Router->BindRoute(
+			FHttpPath(Route),
+			EHttpServerRequestVerbs::VERB_POST,
+			FHttpRequestHandler::CreateLambda(
+				[this](const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
+				{
+					if (OnRequestReceived)
+					{
+						OnRequestReceived(Request);
+					}
+
+					const FUTF8ToTCHAR BodyChars(reinterpret_cast<const ANSICHAR*>(Request.Body.GetData()), Request.Body.Num());
+					const FString Body(BodyChars.Length(), BodyChars.Get());
+
+					// NOTE: Retry-After keeps the retries immediate, the backoff itself isn't what's tested here
+					const int32 Attempt = NumReceived.FindOrAdd(Body)++;
+					const TArray<int32>* Script = Scripts.Find(Body);
+					const int32 Code = Script && Script->IsValidIndex(Attempt) ? (*Script)[Attempt] : UnscriptedCode;
+					if (Code == 0)
+					{
+						return true;
+					}
+
+					TUniquePtr<FHttpServerResponse> Response = FHttpServerResponse::Create(TEXT("{}"), TEXT("application/json"));
+					Response->Code = static_cast<EHttpServerResponseCodes>(Code);
+					Response->Headers.Add(TEXT("Retry-After"), {TEXT("0")});
+					OnComplete(MoveTemp(Response));
+					return true;
+				}
+			)
+		);
+		FHttpServerModule::Get().StartAllListeners();
+	}
+
+	void Stop()
+	{
+		if (Router && RouteHandle)
+		{
+			Router->UnbindRoute(RouteHandle);
+		}
+	}
+};
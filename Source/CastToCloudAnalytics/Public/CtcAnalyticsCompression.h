@@ -0,0 +1,21 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include "CtcSharedSettings.h"
+
+/**
+ * Helpers to compress the analytics request bodies
+ */
+struct CASTTOCLOUDANALYTICS_API FCtcAnalyticsCompression
+{
+	/**
+	 * Compresses Input using the requested method. Zstd falls back to Gzip when no Zstd compression format is registered
+	 * @return The method actually used, None if the data was left uncompressed (e.g.: compressing didn't make it smaller)
+	 */
+	static ECtcAnalyticsCompression Compress(ECtcAnalyticsCompression Method, int32 Level, TConstArrayView<uint8> Input, TArray<uint8>& OutCompressed);
+	/**
+	 * Value of the HTTP Content-Encoding header for the given method
+	 */
+	static const TCHAR* GetContentEncoding(ECtcAnalyticsCompression Method);
+};
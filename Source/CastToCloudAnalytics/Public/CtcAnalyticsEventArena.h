@@ -0,0 +1,68 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+/**
+ * Bump allocator holding cached events until they are flushed. Allocating is lock-free unless a new block is needed, and
+ * memory is only given back all at once by Reset, which keeps the blocks around for the next round.
+ */
+class CASTTOCLOUDANALYTICS_API FCtcAnalyticsEventArena
+{
+public:
+	FCtcAnalyticsEventArena() = default;
+	~FCtcAnalyticsEventArena();
+	UE_NONCOPYABLE(FCtcAnalyticsEventArena);
+
+	/**
+	 * Returns Size bytes aligned to Alignment, valid until the next Reset. Safe to call from any thread
+	 */
+	void* Allocate(SIZE_T Size, SIZE_T Alignment);
+	/**
+	 * Makes all the memory available again. Nothing can reference the arena nor allocate from it while it runs
+	 * @param bReleaseMemory Whether to free the blocks as well. Otherwise only the blocks unused since the last reset are freed
+	 */
+	void Reset(bool bReleaseMemory = false);
+
+	/**
+	 * Each event allocated from the arena holds a reference until it's consumed. The arena can only be reset once there is none left
+	 */
+	void AddReferences(int32 Num) { NumReferences.fetch_add(Num); }
+	void ReleaseReferences(int32 Num) { NumReferences.fetch_sub(Num); }
+	bool IsReferenced() const { return NumReferences.load() > 0; }
+
+private:
+	struct FBlock
+	{
+		uint8* Data = nullptr;
+		SIZE_T Capacity = 0;
+		/**
+		 * Bytes handed out from the block. Keeps growing past the capacity when several threads run out of room at once
+		 */
+		std::atomic<SIZE_T> Used = 0;
+	};
+
+	/**
+	 * Moves to the next block once FullBlock can't fit an allocation, or creates a dedicated block for allocations
+	 * bigger than BlockSize
+	 * @return The allocation if it was served from a dedicated block, nullptr if it has to be retried
+	 */
+	void* AllocateSlow(FBlock* FullBlock, SIZE_T Size, SIZE_T Alignment);
+	static FBlock* NewBlock(SIZE_T Capacity);
+	static void DeleteBlock(FBlock* Block);
+
+	static constexpr SIZE_T BlockSize = 64 * 1024;
+	static constexpr SIZE_T BlockAlignment = 16;
+
+	std::atomic<FBlock*> CurrentBlock = nullptr;
+	std::atomic<int32> NumReferences = 0;
+
+	/**
+	 * Guards the block lists, only taken when the current block is full
+	 */
+	FCriticalSection Lock;
+	TArray<FBlock*> Blocks;
+	int32 CurrentBlockIndex = INDEX_NONE;
+	TArray<FBlock*> LargeBlocks;
+};
@@ -0,0 +1,101 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CtcSharedSettings.h"
+
+/**
+ * Decides which events get recorded according to the sampling and rate limits configured per event name, and which
+ * ones are critical. The settings are compiled into an immutable snapshot, so checking an event is a single lookup and
+ * never takes a lock. Event names are case insensitive, like the settings maps they come from.
+ */
+class CASTTOCLOUDANALYTICS_API FCtcAnalyticsEventFilter
+{
+public:
+	enum class EResult
+	{
+		Pass,
+		SampledOut,
+		RateLimited
+	};
+
+	FCtcAnalyticsEventFilter();
+	~FCtcAnalyticsEventFilter();
+
+	/**
+	 * Rebuilds the table from the settings. Does nothing when the settings haven't changed since the last call
+	 */
+	void Configure(const UCtcSharedSettings& Settings);
+	/**
+	 * Sets the session the sampling decisions are drawn for. Safe to call from any thread
+	 */
+	void SetSessionId(const FString& SessionId);
+	/**
+	 * Checks an event against the sampling and rate limits. Safe to call from any thread
+	 */
+	EResult Check(FStringView EventName) const;
+	/**
+	 * Whether an event has to be sent right away. Safe to call from any thread
+	 */
+	bool IsCritical(FStringView EventName) const;
+
+private:
+	/**
+	 * Compiled sample rate and rate limit of an event name
+	 */
+	struct FRule
+	{
+		float SampleRate = 1.0f;
+		/**
+		 * Index of the rule's arrival time in the snapshot, INDEX_NONE if the rule isn't rate limited
+		 */
+		int32 BucketIndex = INDEX_NONE;
+		double EmissionInterval = 0.0;
+		double BurstTolerance = 0.0;
+	};
+
+	/**
+	 * Everything compiled from the settings. Never modified once published, except for the arrival times
+	 */
+	struct FSnapshot
+	{
+		TMap<FString, FRule> Rules;
+		FRule DefaultRule;
+		TSet<FString> CriticalEventNames;
+		/**
+		 * Whether any rule can reject an event, skips the lookup entirely when nothing is configured
+		 */
+		bool bCanReject = false;
+		/**
+		 * Theoretical arrival time of the next event of every rate limited rule, indexed by FRule::BucketIndex
+		 */
+		TUniquePtr<std::atomic<double>[]> ArrivalTimes;
+	};
+
+	static FRule CompileRule(const FCtcAnalyticsEventSampling& Sampling, int32& NumBuckets);
+	/**
+	 * Whether the session records the events of a rule, from the hash of the rule's event name
+	 */
+	bool IsSampledIn(const FRule& Rule, uint32 EventNameHash) const;
+	/**
+	 * Lets an event through the rule's rate limit, following the generic cell rate algorithm. Lock free
+	 */
+	static bool ConsumeToken(const FRule& Rule, std::atomic<double>& ArrivalTime);
+
+	std::atomic<const FSnapshot*> Snapshot = nullptr;
+	std::atomic<uint32> SessionIdHash = 0;
+	/**
+	 * Snapshots replaced by Configure. Other threads may still be reading them, they're only freed with the filter.
+	 * Only a change to the settings replaces the snapshot, sessions and resets reuse it
+	 */
+	TArray<TUniquePtr<const FSnapshot>> Snapshots;
+	/**
+	 * Settings the current snapshot was compiled from
+	 */
+	TMap<FString, FCtcAnalyticsEventSampling> ConfiguredEventSampling;
+	FCtcAnalyticsEventSampling ConfiguredDefaultEventSampling;
+	TSet<FString> ConfiguredCriticalEvents;
+	FCriticalSection ConfigureLock;
+};
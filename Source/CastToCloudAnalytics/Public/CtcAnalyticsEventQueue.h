@@ -0,0 +1,111 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+/**
+ * Link embedded in the elements of a TCtcAnalyticsEventQueue
+ */
+struct FCtcAnalyticsQueueNode
+{
+	std::atomic<FCtcAnalyticsQueueNode*> QueueNext = nullptr;
+};
+
+/**
+ * Lock-free multiple producers single consumer queue of elements deriving from FCtcAnalyticsQueueNode. Unlike TQueue it
+ * never allocates, elements are linked in place and their memory stays owned by the caller.
+ */
+template <typename ElementType>
+class TCtcAnalyticsEventQueue
+{
+public:
+	TCtcAnalyticsEventQueue() : Head(&Stub), Tail(&Stub) {}
+	UE_NONCOPYABLE(TCtcAnalyticsEventQueue);
+
+	/**
+	 * Adds an element at the end of the queue. Safe to call from any thread
+	 */
+	void Enqueue(ElementType* Element)
+	{
+		Push(Element);
+	}
+
+	/**
+	 * Returns the first element without removing it, nullptr if the queue is empty. Consumer only
+	 */
+	ElementType* Peek()
+	{
+		// The stub is a placeholder which lets the last element be removed, it's skipped as soon as there is something after it
+		if (Tail == &Stub)
+		{
+			FCtcAnalyticsQueueNode* Next = Stub.QueueNext.load(std::memory_order_acquire);
+			if (!Next)
+			{
+				return nullptr;
+			}
+			Tail = Next;
+		}
+
+		return static_cast<ElementType*>(Tail);
+	}
+
+	/**
+	 * Removes and returns the first element. Consumer only
+	 * @return Nullptr if the queue is empty, or if a producer is still linking the element following the first one
+	 */
+	ElementType* Dequeue()
+	{
+		ElementType* First = Peek();
+		if (!First)
+		{
+			return nullptr;
+		}
+
+		FCtcAnalyticsQueueNode* Next = First->QueueNext.load(std::memory_order_acquire);
+		if (!Next)
+		{
+			if (First != Head.load(std::memory_order_acquire))
+			{
+				return nullptr;
+			}
+
+			// NOTE: The first element is also the last one, the stub goes after it so it can be unlinked
+			Push(&Stub);
+			Next = First->QueueNext.load(std::memory_order_acquire);
+			if (!Next)
+			{
+				return nullptr;
+			}
+		}
+
+		Tail = Next;
+		return First;
+	}
+
+	/**
+	 * Consumer only
+	 */
+	bool IsEmpty()
+	{
+		return Peek() == nullptr;
+	}
+
+private:
+	void Push(FCtcAnalyticsQueueNode* Node)
+	{
+		Node->QueueNext.store(nullptr, std::memory_order_relaxed);
+		FCtcAnalyticsQueueNode* Previous = Head.exchange(Node, std::memory_order_acq_rel);
+		Previous->QueueNext.store(Node, std::memory_order_release);
+	}
+
+	FCtcAnalyticsQueueNode Stub;
+	/**
+	 * Last element, where producers link new ones
+	 */
+	std::atomic<FCtcAnalyticsQueueNode*> Head;
+	/**
+	 * First element, only accessed by the consumer
+	 */
+	FCtcAnalyticsQueueNode* Tail;
+};
@@ -0,0 +1,60 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <Tasks/Pipe.h>
+
+#include <atomic>
+
+class IFileHandle;
+
+/**
+ * Append-only newline delimited JSON sink used by -AnalyticsToFile. Writes happen in order on a background pipe,
+ * each append costs the size of the batch and files are rotated once they grow past a fixed size.
+ */
+class CASTTOCLOUDANALYTICS_API FCtcAnalyticsFileSink
+{
+public:
+	explicit FCtcAnalyticsFileSink(const FString& InDirectory);
+	~FCtcAnalyticsFileSink();
+
+	/**
+	 * Queues newline delimited events to be appended to the session's file. Blocks if too much data is already waiting to be written
+	 */
+	void Append(const FString& SessionId, TArray<uint8>&& Lines);
+	/**
+	 * Blocks until every queued append reached the file
+	 */
+	void WaitForPendingWrites();
+	/**
+	 * Flushes the current file all the way to disk and closes it. Expected to be called when the session ends
+	 */
+	void Close();
+
+private:
+	/**
+	 * Writes the lines into the current file, opening or rotating it when needed. Only called from the WritePipe
+	 */
+	void WriteLines(const FString& SessionId, const TArray<uint8>& Lines);
+	/**
+	 * Flushes and closes the current file handle. Only called from the WritePipe
+	 */
+	void CloseFile();
+
+	/**
+	 * Size after which the next append goes to a new file
+	 */
+	static constexpr int64 MaxFileSize = 64 * 1024 * 1024;
+	/**
+	 * Amount of queued data after which Append waits for the writes to catch up
+	 */
+	static constexpr int64 MaxPendingBytes = 16 * 1024 * 1024;
+
+	FString Directory;
+	UE::Tasks::FPipe WritePipe{TEXT("CtcAnalyticsFileSinkPipe")};
+	std::atomic<int64> PendingBytes = 0;
+
+	TUniquePtr<IFileHandle> FileHandle;
+	FString FileSessionId;
+	int32 FileIndex = 0;
+};
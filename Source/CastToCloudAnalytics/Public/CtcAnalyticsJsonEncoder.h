@@ -0,0 +1,63 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <CoreMinimal.h>
+
+/**
+ * Minimal streaming JSON writer appending UTF-8 bytes straight into a caller provided buffer.
+ * Escaping and number formatting match TJsonWriter so the output can be consumed the same way as the one from FJsonSerializer.
+ */
+class CASTTOCLOUDANALYTICS_API FCtcAnalyticsJsonEncoder
+{
+public:
+	/**
+	 * @param bAfterValue Whether InBuffer already ends with a value of the current object or array, the next one is separated from it
+	 */
+	explicit FCtcAnalyticsJsonEncoder(TArray<uint8>& InBuffer, bool bAfterValue = false);
+
+	void BeginObject();
+	void EndObject();
+	void BeginArray();
+	void EndArray();
+
+	void WriteKey(FStringView Key);
+	/**
+	 * Same as WriteKey, for a key already escaped as a JSON string with its quotes
+	 */
+	void WriteEscapedKey(TConstArrayView<uint8> EscapedKey);
+	void WriteString(FStringView Value);
+	void WriteNumber(double Value);
+	void WriteInteger(int64 Value);
+	void WriteBool(bool bValue);
+	/**
+	 * Writes Value as an ISO 8601 string, with milliseconds or, if bMicroseconds is set, microseconds
+	 */
+	void WriteDateTime(const FDateTime& Value, bool bMicroseconds = false);
+	/**
+	 * Appends bytes which are already valid JSON for the current position (e.g.: a cached value or list of fields). Empty fragments are ignored
+	 */
+	void WriteRaw(TConstArrayView<uint8> Bytes);
+	/**
+	 * Same as WriteRaw, for JSON held in characters which still need converting to UTF-8
+	 */
+	void WriteRaw(FStringView Json);
+
+	void WriteStringField(FStringView Key, FStringView Value);
+	void WriteNumberField(FStringView Key, double Value);
+	void WriteBoolField(FStringView Key, bool bValue);
+
+	/**
+	 * Appends Value as an escaped JSON string (quotes included) converted to UTF-8
+	 */
+	static void AppendEscapedString(TArray<uint8>& OutBuffer, FStringView Value);
+
+private:
+	/**
+	 * Writes the comma separating the previous value of the current object or array, if needed
+	 */
+	void WriteSeparator();
+
+	TArray<uint8>& Buffer;
+	bool bNeedsSeparator = false;
+};
@@ -0,0 +1,76 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include "CtcAnalyticsProvider.h"
+
+/**
+ * Compiles the recording macros out when 0, and keeps the module from creating its provider. Set it from the target rules,
+ * e.g.: GlobalDefinitions.Add("CTC_ANALYTICS_ENABLED=0")
+ */
+#ifndef CTC_ANALYTICS_ENABLED
+#define CTC_ANALYTICS_ENABLED 1
+#endif
+
+/**
+ * Declares a category of events which can be compiled out on its own, e.g.: CTC_ANALYTICS_DECLARE_CATEGORY(Combat, !UE_BUILD_SHIPPING).
+ * Categories are declared at namespace scope, before the macros recording their events
+ */
+#define CTC_ANALYTICS_DECLARE_CATEGORY(Category, bEnabled) \
+	struct FCtcAnalyticsCategory_##Category \
+	{ \
+		static constexpr bool bIsEnabled = CTC_ANALYTICS_ENABLED && (bEnabled); \
+	}
+
+#if CTC_ANALYTICS_ENABLED
+
+/**
+ * Recording macros. The arguments are only evaluated if the category is compiled in and CastToCloud is the active
+ * provider, otherwise the cost is a single branch
+ */
+#define CTC_ANALYTICS_RECORD(Category, EventName, ...) \
+	do \
+	{ \
+		if constexpr (FCtcAnalyticsCategory_##Category::bIsEnabled) \
+		{ \
+			if (FCtcAnalyticsProvider* CtcProvider = FCtcAnalyticsProvider::GetActive()) \
+			{ \
+				CtcProvider->Record(EventName, ##__VA_ARGS__); \
+			} \
+		} \
+	} \
+	while (0)
+
+#define CTC_ANALYTICS_RECORD_TYPED(Category, Event) \
+	do \
+	{ \
+		if constexpr (FCtcAnalyticsCategory_##Category::bIsEnabled) \
+		{ \
+			if (FCtcAnalyticsProvider* CtcProvider = FCtcAnalyticsProvider::GetActive()) \
+			{ \
+				CtcProvider->RecordTyped(Event); \
+			} \
+		} \
+	} \
+	while (0)
+
+#define CTC_ANALYTICS_RECORD_EVENT(Category, EventName, Attributes) \
+	do \
+	{ \
+		if constexpr (FCtcAnalyticsCategory_##Category::bIsEnabled) \
+		{ \
+			if (FCtcAnalyticsProvider* CtcProvider = FCtcAnalyticsProvider::GetActive()) \
+			{ \
+				CtcProvider->RecordEvent(EventName, Attributes); \
+			} \
+		} \
+	} \
+	while (0)
+
+#else
+
+#define CTC_ANALYTICS_RECORD(Category, EventName, ...) do { } while (0)
+#define CTC_ANALYTICS_RECORD_TYPED(Category, Event) do { } while (0)
+#define CTC_ANALYTICS_RECORD_EVENT(Category, EventName, Attributes) do { } while (0)
+
+#endif
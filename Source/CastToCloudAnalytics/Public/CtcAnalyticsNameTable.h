@@ -0,0 +1,90 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+/**
+ * Append-only table interning strings which repeat across many events, so events only carry a small ID. Every name is
+ * escaped as a JSON string once when it's added, serializing it is a copy of those bytes.
+ */
+class CASTTOCLOUDANALYTICS_API FCtcAnalyticsNameTable
+{
+public:
+	FCtcAnalyticsNameTable();
+
+	/**
+	 * ID of the empty string
+	 */
+	static constexpr int32 EmptyId = 0;
+
+	/**
+	 * Returns the ID of Name, adding it the first time it's seen. Names are case sensitive. Safe to call from any thread,
+	 * names a thread looked up recently are found again without locking
+	 * @return INDEX_NONE if the table is full, the caller has to keep the name itself
+	 */
+	int32 Intern(FStringView Name);
+	/**
+	 * ID of the first name interned which only differs by case from the name of Id. Compares names case insensitively with
+	 * integers. Never locks nor allocates
+	 */
+	int32 GetFoldedId(int32 Id) const;
+	/**
+	 * Name of an ID returned by Intern. Never locks nor allocates
+	 */
+	const FString& GetName(int32 Id) const;
+	/**
+	 * Name of an ID returned by Intern escaped as a JSON string, quotes included. Never locks nor allocates
+	 */
+	TConstArrayView<uint8> GetEscapedName(int32 Id) const;
+
+private:
+	struct FEntry
+	{
+		FString Name;
+		TArray<uint8> EscapedName;
+		int32 FoldedId = 0;
+	};
+
+	/**
+	 * Compares names case sensitively, unlike the default key functions
+	 */
+	struct FCaseSensitiveKeyFuncs : TDefaultMapKeyFuncs<FStringView, int32, false>
+	{
+		static bool Matches(FStringView A, FStringView B) { return A.Equals(B, ESearchCase::CaseSensitive); }
+	};
+
+	const FEntry& GetEntry(int32 Id) const;
+	/**
+	 * Looks Name up in the table itself, taking the lock
+	 */
+	int32 InternLocked(FStringView Name);
+	/**
+	 * Result of Intern for a name which doesn't fit, warns the first time
+	 */
+	int32 RejectName(FStringView Name);
+
+	/**
+	 * Entries are allocated in blocks which never move, so they can be read without the lock while new names are added
+	 */
+	static constexpr int32 BlockSize = 1024;
+	static constexpr int32 MaxBlocks = 64;
+	TUniquePtr<FEntry[]> Blocks[MaxBlocks];
+	std::atomic<int32> NumEntries = 0;
+
+	/**
+	 * Tells the tables apart in the per-thread lookup cache, which is shared by all of them
+	 */
+	uint32 TableId = 0;
+
+	/**
+	 * Guards the lookup of existing names. Keys point into the entries
+	 */
+	FRWLock Lock;
+	TMap<FStringView, int32, FDefaultSetAllocator, FCaseSensitiveKeyFuncs> Ids;
+	/**
+	 * First ID of every name regardless of case, the default key functions ignore it
+	 */
+	TMap<FStringView, int32> FoldedIds;
+	std::atomic<bool> bFullWarningLogged = false;
+};
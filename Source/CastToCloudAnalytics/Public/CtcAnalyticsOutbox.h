@@ -0,0 +1,107 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+class IFileHandle;
+
+#include "CtcSharedSettings.h"
+
+/**
+ * Durable queue of outbound request bodies. Every batch is persisted as a segment file before being sent and deleted
+ * once the backend acknowledges it, so batches from crashed or offline sessions can be uploaded on the next launch.
+ */
+class CASTTOCLOUDANALYTICS_API FCtcAnalyticsOutbox
+{
+public:
+	explicit FCtcAnalyticsOutbox(const FString& InDirectory);
+	~FCtcAnalyticsOutbox();
+
+	/**
+	 * Persists a request body. Safe to call from any thread
+	 * @return Path of the new segment, empty if it couldn't be written
+	 */
+	FString Store(TConstArrayView<uint8> Body, ECtcAnalyticsCompression ContentEncoding);
+	/**
+	 * Deletes a segment once it doesn't need to be sent anymore
+	 */
+	void Remove(const FString& SegmentPath);
+	/**
+	 * Returns the segments left behind by previous runs of the application. Each segment is only returned once
+	 */
+	TArray<FString> TakeRecoveredSegments();
+	/**
+	 * Caps the disk space taken by the segments, the oldest ones are deleted past it. Segments left by previous runs which
+	 * are older than MaxSegmentAge seconds are deleted instead of being recovered, 0 keeps them regardless of age
+	 */
+	void SetLimits(int64 InMaxSize, double InMaxSegmentAge);
+	/**
+	 * Reads back a segment written by Store
+	 */
+	static bool Load(const FString& SegmentPath, TArray<uint8>& OutBody, ECtcAnalyticsCompression& OutContentEncoding);
+
+	/**
+	 * Preallocates the buffer and opens the file of the crash segment, nothing can be allocated once the application is crashing
+	 */
+	void PrepareCrashSegment(int32 Capacity);
+	/**
+	 * Buffer the crash-time body is written to, nullptr if the crash segment isn't prepared. Never grow it past its capacity
+	 */
+	TArray<uint8>* GetCrashBuffer();
+	/**
+	 * Writes the crash buffer to the crash segment with plain file I/O and no allocation. Safe to call from a crash handler
+	 */
+	bool CommitCrashSegment();
+	/**
+	 * Closes the crash segment once the application exits normally, deleting it unless something was committed to it
+	 */
+	void DiscardCrashSegment();
+
+private:
+	/**
+	 * Segment waiting on disk, along with its size
+	 */
+	struct FSegment
+	{
+		FString Path;
+		int64 Size = 0;
+	};
+
+	/**
+	 * Lists the segments already on disk the first time it's called, deleting the expired ones. Called with the lock held
+	 */
+	void ListSegments();
+	/**
+	 * Deletes the oldest segments until they fit in MaxSize again. Called with the lock held
+	 */
+	void EvictOldestSegments();
+
+	/**
+	 * Identifies the segment format, stored at the start of every segment
+	 */
+	static constexpr uint32 SegmentMagic = 0x31435443; // "CTC1"
+
+	FString Directory;
+	/**
+	 * Prefix of all the segments written by this run, used to tell them apart from the recovered ones
+	 */
+	FString RunPrefix;
+	std::atomic<uint32> NextSegmentIndex = 0;
+	std::atomic<bool> bRecoveredSegmentsTaken = false;
+
+	/**
+	 * Segments on disk, oldest first, and their total size
+	 */
+	FCriticalSection SegmentsLock;
+	TArray<FSegment> Segments;
+	int64 SegmentsSize = 0;
+	bool bSegmentsListed = false;
+	std::atomic<int64> MaxSize = MAX_int64;
+	std::atomic<double> MaxSegmentAge = 0.0;
+
+	FString CrashSegmentPath;
+	TUniquePtr<IFileHandle> CrashSegmentHandle;
+	TArray<uint8> CrashBuffer;
+	bool bCrashSegmentCommitted = false;
+};
@@ -2,13 +2,37 @@
 
 #pragma once
 
+#include <Containers/StaticArray.h>
+#include <Containers/Ticker.h>
 #include <Interfaces/IAnalyticsProvider.h>
-#include <Interfaces/IHttpRequest.h>
+#include <Tasks/Pipe.h>
+
+#include <atomic>
+#include <type_traits>
+
+#include "CtcAnalyticsEventArena.h"
+#include "CtcAnalyticsEventFilter.h"
+#include "CtcAnalyticsEventQueue.h"
+#include "CtcAnalyticsFileSink.h"
+#include "CtcAnalyticsNameTable.h"
+#include "CtcAnalyticsOutbox.h"
+#include "CtcAnalyticsSendScheduler.h"
+#include "CtcAnalyticsSpillFile.h"
+#include "CtcAnalyticsTypedEvent.h"
+#include "CtcSharedSettings.h"
+
+class FCtcAnalyticsJsonEncoder;
 
 class CASTTOCLOUDANALYTICS_API FCtcAnalyticsProvider : public IAnalyticsProvider
 {
 public:
 	FCtcAnalyticsProvider();
+	/**
+	 * Provider which isn't registered anywhere and never flushes on its own, keeping its files and name tables to itself in
+	 * StorageDir. Lets the automation tests record events next to the active provider
+	 */
+	explicit FCtcAnalyticsProvider(const FString& StorageDir);
+	virtual ~FCtcAnalyticsProvider() override;
 
 	// ~Begin IAnalyticsProvider interface
 	virtual bool StartSession(const TArray<FAnalyticsEventAttribute>& Attributes) override;
@@ -25,30 +49,531 @@ public:
 	virtual void RecordEvent(const FString& EventName, const TArray<FAnalyticsEventAttribute>& Attributes) override;
 	// ~End IAnalyticsProvider interface
 
-	void RecordEventWithTransform(const FString& EventName, const FTransform& Transform, const TArray<FAnalyticsEventAttribute>& Attributes);
+	using IAnalyticsProvider::RecordEvent;
+	/**
+	 * Same as RecordEvent, reading the name and the attributes in place. Temporaries can be passed without being copied
+	 */
+	void RecordEvent(FStringView EventName, TConstArrayView<FAnalyticsEventAttribute> Attributes);
+	void RecordEventWithTransform(FStringView EventName, const FTransform& Transform, TConstArrayView<FAnalyticsEventAttribute> Attributes);
+	/**
+	 * Records an event from key value pairs, e.g.: Record(TEXT("Hit"), TEXT("damage"), 12.5f, TEXT("weapon"), WeaponName).
+	 * Numbers and booleans stay unboxed until the event is serialized, nothing is allocated besides the event itself
+	 */
+	template <typename... ArgTypes>
+	void Record(FStringView EventName, const ArgTypes&... KeysAndValues)
+	{
+		RecordInternal(EventName, nullptr, KeysAndValues...);
+	}
+	template <typename... ArgTypes>
+	void RecordWithTransform(FStringView EventName, const FTransform& Transform, const ArgTypes&... KeysAndValues)
+	{
+		RecordInternal(EventName, &Transform, KeysAndValues...);
+	}
+	/**
+	 * Records an event described by a struct declaring its name and its fields, e.g.:
+	 *   struct FHitEvent
+	 *   {
+	 *       static constexpr const TCHAR* CtcEventName = TEXT("Hit");
+	 *       static constexpr auto CtcEventFields() { return CtcAnalyticsFields(CtcAnalyticsField(TEXT("damage"), &FHitEvent::Damage)); }
+	 *       float Damage = 0.0f;
+	 *   };
+	 * The name and the keys are interned once per struct, recording an event only copies the values of its fields
+	 */
+	template <typename EventType>
+	void RecordTyped(const EventType& Event)
+	{
+		constexpr int32 NumFields = std::tuple_size_v<decltype(EventType::CtcEventFields())>;
+
+		bool bCritical;
+		if (!IsAcceptingEvents() || !FilterEvent(EventType::CtcEventName, bCritical))
+		{
+			return;
+		}
+
+		const TTypedEventIds<EventType> Ids = GetTypedEventIds<EventType>();
+
+		TStackAttributes<NumFields> Attributes;
+		int32 Index = 0;
+		std::apply(
+			[&Event, &Ids, &Attributes, &Index](const auto&... Fields)
+			{
+				((Attributes[Index] = MakeAttribute(Ids[Index + 1], Fields.Key, Event.*(Fields.Member)), ++Index), ...);
+			},
+			EventType::CtcEventFields()
+		);
+		CacheEvent(EventType::CtcEventName, Ids[0], nullptr, MakeArrayView(Attributes.GetData(), NumFields), bCritical);
+	}
+
+	/**
+	 * Time the last shutdown flush added to the exit or the end of PIE, in seconds
+	 */
+	double GetLastShutdownFlushDuration() const { return LastShutdownFlushDuration; }
+
+	/**
+	 * The provider to record events with, null if CastToCloud isn't the active analytics provider or isn't allowed to send
+	 * events from this configuration. Only a couple of loads once that's resolved, callers can skip building their events
+	 * entirely when it returns null
+	 */
+	static FCtcAnalyticsProvider* GetActive()
+	{
+		FCtcAnalyticsProvider* Provider = Instance.load(std::memory_order_acquire);
+		return Provider && Provider->IsAcceptingEvents() ? Provider : nullptr;
+	}
 
 private:
 	/**
-	 * Internal Record Event function used by all possible tracking methods
+	 * Lets the automation tests measure the recording internals
+	 */
+	friend struct FCtcAnalyticsProviderTestAccess;
+
+	FCtcAnalyticsProvider(const FString& StorageDir, bool bOwnNameTables);
+
+	/**
+	 * Attribute of a cached event. Keeps the type of the value, numbers and booleans recorded through Record are unboxed
+	 */
+	struct FCachedAttribute
+	{
+		enum class EType : uint8
+		{
+			String,
+			Integer,
+			Number,
+			Bool,
+			JsonFragment
+		};
+
+		/**
+		 * The key is only kept when it couldn't be interned, i.e. InKeyId is INDEX_NONE
+		 */
+		static FCachedAttribute MakeString(int32 InKeyId, FStringView InKey, FStringView InValue);
+		static FCachedAttribute MakeInteger(int32 InKeyId, FStringView InKey, int64 InValue);
+		static FCachedAttribute MakeNumber(int32 InKeyId, FStringView InKey, double InValue);
+		static FCachedAttribute MakeBool(int32 InKeyId, FStringView InKey, bool bInValue);
+		static FCachedAttribute MakeJsonFragment(int32 InKeyId, FStringView InKey, FStringView InValue);
+
+		/**
+		 * Name of the attribute, interned in AttributeKeys. INDEX_NONE if the table was full, Key holds the name instead
+		 */
+		int32 KeyId = FCtcAnalyticsNameTable::EmptyId;
+		FStringView Key;
+		EType Type = EType::String;
+		/**
+		 * Characters of strings and JSON fragments, empty for the other types
+		 */
+		FStringView Value;
+		/**
+		 * Value of the other types. Booleans are stored as 0 or 1
+		 */
+		union
+		{
+			int64 IntegerValue = 0;
+			double NumberValue;
+		};
+	};
+	/**
+	 * Data structure to hold all the information about an individual event. Cached events live in an event arena along with
+	 * their transform and attributes, events built on the stack only point to the caller's data
+	 */
+	struct FCachedEvent : FCtcAnalyticsQueueNode
+	{
+		/**
+		 * Arena holding the event, referenced until the event is consumed. Null for events built on the stack
+		 */
+		FCtcAnalyticsEventArena* Arena = nullptr;
+		/**
+		 * Name of the event, interned in EventNames. INDEX_NONE if the table was full, Name holds the name instead
+		 */
+		int32 NameId = FCtcAnalyticsNameTable::EmptyId;
+		FStringView Name;
+		/**
+		 * FPlatformTime::Cycles64 when the event was recorded. Turned into wall-clock time by the clock anchor of its batch
+		 */
+		uint64 Cycles = 0;
+		/**
+		 * World the event was recorded in, interned in WorldNames
+		 */
+		int32 WorldId = FCtcAnalyticsNameTable::EmptyId;
+		const FTransform* Transform = nullptr;
+		TConstArrayView<FCachedAttribute> Attributes;
+		/**
+		 * Memory taken by the event while it waits in the cache
+		 */
+		int32 MemorySize = 0;
+	};
+	/**
+	 * Wall-clock time matching a FPlatformTime::Cycles64 reading, used to convert event timestamps
+	 */
+	struct FClockAnchor
+	{
+		uint64 Cycles = 0;
+		FDateTime Time;
+
+		/**
+		 * Reads both clocks right now
+		 */
+		static FClockAnchor Capture();
+		FDateTime ToDateTime(uint64 EventCycles) const;
+	};
+	/**
+	 * Where a batch ends up once it's serialized
+	 */
+	enum class EBatchDestination
+	{
+		Backend,
+		File,
+		Log,
+		Discard
+	};
+	/**
+	 * Where the events go and how to reach the backend. Resolved from the command line and the settings once, not per flush
+	 */
+	struct FSendPolicy
+	{
+		EBatchDestination Destination = EBatchDestination::Backend;
+		FString EventsUrl;
+		FString ApiKey;
+	};
+	/**
+	 * Session information shared by all the events of a batch. Built on the game thread, read-only afterwards
+	 */
+	struct FBatchContext
+	{
+		FString SessionID;
+		FString UserID;
+		/**
+		 * Built-in and default attributes merged in the order they end up in every event's properties. Keys are interned in
+		 * AttributeKeys, values and the keys which didn't fit point to ConstantEventPropertyValues
+		 */
+		TArray<FCachedAttribute> ConstantEventProperties;
+		/**
+		 * Folded IDs of the constant property keys, INDEX_NONE if one of the keys isn't interned
+		 */
+		TSet<int32> ConstantEventPropertyKeys;
+		TArray<FString> ConstantEventPropertyValues;
+		/**
+		 * Pre-encoded JSON fragments spliced into every event. Rebuilt only when the context is invalidated
+		 */
+		TArray<uint8> SessionFieldsFragment;
+		TArray<uint8> EventPropertiesFragment;
+		TArray<uint8> UserPropertiesFragment;
+		FSendPolicy SendPolicy;
+		bool bEnableGeolocationAttribution = true;
+		ECtcAnalyticsWireFormat WireFormat = ECtcAnalyticsWireFormat::PerEvent;
+		ECtcAnalyticsCompression Compression = ECtcAnalyticsCompression::None;
+		int32 CompressionLevel = 0;
+		int64 MaxBatchSize = MAX_int64;
+		int32 MaxBatchEvents = MAX_int32;
+		bool bHighPrecisionTimestamps = false;
+		bool bTypedAttributeValues = false;
+		bool bSendBatchSequence = false;
+	};
+	/**
+	 * Part of a batch small enough to be sent on its own
+	 */
+	struct FBatchChunk
+	{
+		/**
+		 * UTF-8 JSON produced by the serialization. The full request for the backend, the events array for local sinks
+		 */
+		TArray<uint8> Body;
+		/**
+		 * Offset and length of every serialized event inside Body
+		 */
+		TArray<TPair<int32, int32>> EventSpans;
+		/**
+		 * Compression applied to Body, if any
+		 */
+		ECtcAnalyticsCompression ContentEncoding = ECtcAnalyticsCompression::None;
+		/**
+		 * Position of the chunk among all the requests of the session. INDEX_NONE for local sinks
+		 */
+		int32 Sequence = INDEX_NONE;
+	};
+	/**
+	 * Group of events flowing through the flush pipeline together
 	 */
-	void RecordEventInternal(const FString& EventName, TOptional<FTransform>& Transform, const TArray<FAnalyticsEventAttribute>& Attributes);
+	struct FBatch
+	{
+		explicit FBatch(const TSharedRef<const FBatchContext>& InContext) : Context(InContext) {}
+		/**
+		 * Releases the events, letting their arenas be reused
+		 */
+		~FBatch();
+
+		TSharedRef<const FBatchContext> Context;
+		EBatchDestination Destination = EBatchDestination::Backend;
+		TArray<FCachedEvent*> Events;
+		/**
+		 * Captured once all the events are in the batch, every timestamp of the batch is converted from it
+		 */
+		FClockAnchor ClockAnchor;
+		/**
+		 * Serialized events. Batches going to the backend are split to honor the configured size and event count limits
+		 */
+		TArray<FBatchChunk> Chunks;
+		/**
+		 * Whether the batch travels through the critical lane
+		 */
+		bool bCritical = false;
+	};
+
+	/**
+	 * Internal Record Event function used by all the tracking methods taking FAnalyticsEventAttribute. Safe to call from any thread
+	 */
+	void RecordEventInternal(FStringView EventName, const FTransform* Transform, TConstArrayView<FAnalyticsEventAttribute> Attributes);
+	/**
+	 * Attributes of an event built on the stack by the recording templates. One slot minimum, zero sized arrays aren't allowed
+	 */
+	template <int32 NumAttributes>
+	using TStackAttributes = TStaticArray<FCachedAttribute, FMath::Max(NumAttributes, 1)>;
+	/**
+	 * Internal Record function building the attributes from key value pairs on the stack. Safe to call from any thread
+	 */
+	template <typename... ArgTypes>
+	void RecordInternal(FStringView EventName, const FTransform* Transform, const ArgTypes&... KeysAndValues)
+	{
+		static_assert(sizeof...(ArgTypes) % 2 == 0, "Record expects a value after every key");
+		constexpr int32 NumAttributes = sizeof...(ArgTypes) / 2;
+
+		int32 NameId;
+		bool bCritical;
+		if (!AcceptEvent(EventName, NameId, bCritical))
+		{
+			return;
+		}
+
+		TStackAttributes<NumAttributes> Attributes;
+		MakeAttributes(Attributes.GetData(), KeysAndValues...);
+		CacheEvent(EventName, NameId, Transform, MakeArrayView(Attributes.GetData(), NumAttributes), bCritical);
+	}
+	void MakeAttributes(FCachedAttribute* OutAttributes) {}
+	template <typename ValueType, typename... ArgTypes>
+	void MakeAttributes(FCachedAttribute* OutAttributes, FStringView Key, const ValueType& Value, const ArgTypes&... KeysAndValues)
+	{
+		*OutAttributes = MakeAttribute(AttributeKeys.Intern(Key), Key, Value);
+		MakeAttributes(OutAttributes + 1, KeysAndValues...);
+	}
+	template <typename ValueType>
+	static FCachedAttribute MakeAttribute(int32 KeyId, FStringView Key, const ValueType& Value)
+	{
+		if constexpr (std::is_same_v<ValueType, bool>)
+		{
+			return FCachedAttribute::MakeBool(KeyId, Key, Value);
+		}
+		else if constexpr (std::is_integral_v<ValueType> || std::is_enum_v<ValueType>)
+		{
+			return FCachedAttribute::MakeInteger(KeyId, Key, static_cast<int64>(Value));
+		}
+		else if constexpr (std::is_floating_point_v<ValueType>)
+		{
+			return FCachedAttribute::MakeNumber(KeyId, Key, static_cast<double>(Value));
+		}
+		else
+		{
+			return FCachedAttribute::MakeString(KeyId, Key, FStringView(Value));
+		}
+	}
+	/**
+	 * Name of a typed event interned in EventNames, followed by its keys interned in AttributeKeys
+	 */
+	template <typename EventType>
+	using TTypedEventIds = TStaticArray<int32, std::tuple_size_v<decltype(EventType::CtcEventFields())> + 1>;
+	/**
+	 * Interned name and keys of a typed event. Resolved once for the shared tables, on every call for tables of a provider's own
+	 */
+	template <typename EventType>
+	TTypedEventIds<EventType> GetTypedEventIds() const
+	{
+		if (!OwnedEventNames)
+		{
+			static const TTypedEventIds<EventType> SharedIds = ResolveTypedEventIds<EventType>();
+			return SharedIds;
+		}
+		return ResolveTypedEventIds<EventType>();
+	}
+	template <typename EventType>
+	TTypedEventIds<EventType> ResolveTypedEventIds() const
+	{
+		TTypedEventIds<EventType> Ids;
+		Ids[0] = EventNames.Intern(EventType::CtcEventName);
+		int32 Index = 1;
+		std::apply(
+			[this, &Ids, &Index](const auto&... Fields)
+			{
+				((Ids[Index++] = AttributeKeys.Intern(Fields.Key)), ...);
+			},
+			EventType::CtcEventFields()
+		);
+		return Ids;
+	}
+	/**
+	 * Runs the checks deciding whether an event gets recorded, before anything about it is built. The name is only interned
+	 * once the event passed them
+	 * @param OutNameId The event name interned in EventNames
+	 * @param bOutCritical Whether the event goes through the critical lane
+	 */
+	bool AcceptEvent(FStringView EventName, int32& OutNameId, bool& bOutCritical);
+	/**
+	 * Checks of AcceptEvent which depend on the event name
+	 */
+	bool FilterEvent(FStringView EventName, bool& bOutCritical);
+	/**
+	 * Copies an accepted event to where it waits for its flush, given its attributes pointing to the caller's data
+	 */
+	void CacheEvent(FStringView EventName, int32 NameId, const FTransform* Transform, TConstArrayView<FCachedAttribute> Attributes, bool bCritical);
+	/**
+	 * Memory an event takes once copied into an event arena
+	 */
+	static int32 GetEventMemorySize(const FCachedEvent& Event);
+	/**
+	 * Copies an event into the active event arena, in a single allocation. Safe to call from any thread
+	 */
+	FCachedEvent* CopyToArena(const FCachedEvent& Source);
+	/**
+	 * Returns the active event arena with a reference added for the event about to be allocated from it
+	 */
+	FCtcAnalyticsEventArena& AcquireEventArena();
+	/**
+	 * Retires the active event arena and activates one no event references anymore, creating it if needed
+	 */
+	void RotateEventArenas();
+	/**
+	 * Drops the references the events hold on their arenas
+	 */
+	static void ReleaseEvents(TConstArrayView<FCachedEvent*> Events);
+	/**
+	 * Writes the binary record of an event spilled to disk
+	 */
+	static void SaveSpilledEvent(FArchive& Ar, const FCachedEvent& Event);
+	/**
+	 * Reads back the binary record of an event spilled to disk into the active event arena
+	 * @return Null if the record is corrupted
+	 */
+	FCachedEvent* LoadSpilledEvent(FArchive& Ar);
+	/**
+	 * Applies the overflow policy when the cached events are over their memory budget
+	 * @return False if the event has to be dropped
+	 */
+	bool AdmitEvent(FStringView EventName, int32 NameId, int32 EventSize, bool& bOutSpill);
+	/**
+	 * Whether an event survives downsampling. Keeps one out of every DownsampleRate events of each name
+	 */
+	bool ShouldKeepDownsampledEvent(int32 NameId);
+	/**
+	 * Drops the oldest cached events until there is room for Size more bytes
+	 */
+	void EvictOldestEvents(int32 Size);
+	/**
+	 * Updates the cache limits from the settings. Read by the recording hot path, which can't access them from any thread
+	 */
+	void RefreshCacheLimits();
+	/**
+	 * Recompiles the sampling and rate limits for the current session
+	 */
+	void RefreshEventFilter();
 	/**
 	 * Updates the built-in attributes applied to all events
 	 */
 	void RefreshBuiltInAttributes();
 	/**
-	 * Callback executed at a fixed interval to regularly send our cached events
+	 * Resolves where the events go from the command line and the allowed configurations. Disallowed configurations stop
+	 * accepting events at ingestion
+	 */
+	void RefreshSendPolicy();
+	/**
+	 * Callback of the flush timer. Sends the cached events unless the frame is over budget, then arms the timer again
+	 */
+	bool OnFlushTimer(float DeltaTime);
+	/**
+	 * Arms the flush timer, replacing the pending one. Safe to call from any thread
+	 * @param bKeepEarlyFlush Whether an early flush requested by a crossed threshold takes precedence over Delay
+	 */
+	void ScheduleFlush(double Delay, bool bKeepEarlyFlush = false);
+	/**
+	 * Displays the provider state on screen when CastToCloud.Analytics.PrintDebugFlags is set
+	 */
+	bool TickDebugDisplay(float DeltaTime);
+	/**
+	 * Send all the events currently in our cache clearing it. The work is done by a pipeline of tasks running on worker threads
+	 * @parm WaitDeadline If set, waits for the requests to complete before returning, up to this FPlatformTime::Seconds
 	 */
-	bool Tick(float DeltaTime);
+	void SendCachedEvents(TOptional<double> WaitDeadline = {});
 	/**
-	 * Callback executed when the HTTP response for the event request is retrieved
+	 * Sends the critical events right away in a batch of their own, bypassing the flush pipeline. Game thread only
 	 */
-	void OnEventResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bSuccess);
+	void SendCriticalEvents();
 	/**
-	 * Send all the events currently in our cache clearing it
-	 * @parm bWait If true, waits for the request to complete before returning
+	 * Returns the immutable snapshot of the session state shared by the batches, rebuilding it if it was invalidated
 	 */
-	void SendCachedEvents(bool bWait = false);
+	TSharedRef<const FBatchContext> GetBatchContext();
+	/**
+	 * First stage of the flush pipeline. Drains all the pending events into a new batch
+	 */
+	TSharedRef<FBatch> SnapshotPendingEvents(const TSharedRef<const FBatchContext>& Context);
+	/**
+	 * Second stage of the flush pipeline. Streams the batch events as JSON straight into the chunk bodies and assigns the
+	 * chunks their sequence
+	 */
+	void SerializeBatch(FBatch& Batch);
+	/**
+	 * Writes a single event object, leaving out the fields carried by the batch context when it's shared
+	 * @param bMergeProperties If false, never allocates and writes colliding property keys twice instead of merging them
+	 */
+	void SerializeEvent(FCtcAnalyticsJsonEncoder& Encoder, const FCachedEvent& Event, const FBatchContext& Context, const FClockAnchor& ClockAnchor, bool bSharedContext, bool bMergeProperties = true) const;
+	/**
+	 * Writes the constant properties followed by the event attributes, merging them only when any of the keys collide
+	 */
+	void WriteEventProperties(FCtcAnalyticsJsonEncoder& Encoder, const FCachedEvent& Event, TConstArrayView<FCachedAttribute> ConstantProperties, const TSet<int32>& ConstantPropertyKeys, TConstArrayView<uint8> ConstantPropertiesFragment, bool bTypedValues) const;
+	/**
+	 * Adds a property, overriding the value in place if the key already exists regardless of case, same as
+	 * FJsonObject::SetField does
+	 */
+	void MergeProperty(TArray<FCachedAttribute, TInlineAllocator<32>>& Properties, TMap<FStringView, int32>& PropertyIndices, const FCachedAttribute& Property) const;
+	void WriteProperty(FCtcAnalyticsJsonEncoder& Encoder, const FCachedAttribute& Attribute, bool bTypedValues) const;
+	/**
+	 * Name of an attribute, whether it's interned or not
+	 */
+	FStringView GetKey(const FCachedAttribute& Attribute) const;
+	/**
+	 * Case insensitive ID of an attribute key, INDEX_NONE if the key isn't interned
+	 */
+	int32 GetFoldedKeyId(const FCachedAttribute& Attribute) const;
+	/**
+	 * Writes the value of an attribute, formatting the unboxed ones
+	 * @param bTypedValues Whether values other than strings are written as native JSON values, otherwise everything is a string
+	 */
+	static void WriteAttributeValue(FCtcAnalyticsJsonEncoder& Encoder, const FCachedAttribute& Attribute, bool bTypedValues);
+	/**
+	 * Upper bound of the size of an event once serialized
+	 */
+	int32 GetMaxSerializedSize(const FCachedEvent& Event, const FBatchContext& Context) const;
+	/**
+	 * Crash-safe flush. Serializes the pending events into the preallocated crash segment of the outbox without allocating
+	 * nor sending anything
+	 * @return False if the crash segment isn't available or full, nothing was written
+	 */
+	bool WriteCrashDump(const TCHAR* EventName);
+	/**
+	 * Third stage of the flush pipeline. Compresses the chunks of batches going to the backend in parallel
+	 */
+	static void CompressBatch(FBatch& Batch);
+	/**
+	 * Last stage of the flush pipeline. Sends the serialized batch to its destination
+	 * @parm WaitDeadline If set, waits for the requests to complete before returning, up to this FPlatformTime::Seconds
+	 */
+	void DispatchBatch(const TSharedRef<FBatch>& Batch, TOptional<double> WaitDeadline);
+	/**
+	 * Sends everything left before the session ends, giving up after ShutdownFlushTimeout
+	 */
+	void FlushForShutdown();
+	/**
+	 * Creates a request to the events endpoint, without body
+	 */
+	static FCtcAnalyticsOutboundRequest MakeOutboundRequest(const FBatchContext& Context);
+	/**
+	 * Uploads in the background the outbox segments left behind by previous runs
+	 */
+	void UploadRecoveredSegments();
 #if WITH_EDITOR
 	/**
 	 * Callback executed when the Play In Editor (PIE) session starts
@@ -61,6 +586,10 @@ private:
 	 * Callback executed when the Play In Editor (PIE) session ends
 	 */
 	void OnPIEEnded(bool bIsSimulating);
+	/**
+	 * Callback executed when the CastToCloud settings are edited
+	 */
+	void OnSettingsChanged(UObject* Settings, FPropertyChangedEvent& PropertyChangedEvent);
 #endif
 	/**
 	 * Callback executed when the engine has started
@@ -86,30 +615,202 @@ private:
 	 * Callback executed when a world's EndPlay is executed
 	 */
 	void OnWorldEndPlay(UWorld* World);
+	/**
+	 * Whether the start and end of a world are recorded as WorldStart and WorldEnd events
+	 */
+	static bool ShouldTrackWorldChange(const UWorld* World);
 	/**
 	 * Resets state variables of the provider in preparation for the next session
 	 */
 	void Reset();
 	/**
-	 * Checks if this instance is set as the active Analytics Provider
+	 * Checks if this instance is set as the active Analytics Provider and its send policy lets the events out. Resolved on
+	 * the game thread for each new session or send policy, a single load here. Safe to call from any thread
 	 */
-	bool IsActiveProvider() const;
+	bool IsAcceptingEvents() const
+	{
+		// NOTE: FAnalytics isn't thread-safe, only the game thread resolves an unknown state on the spot. Other threads reject
+		// events until it's resolved, by the next flush tick at the latest
+		const EAcceptState CurrentState = AcceptState.load(std::memory_order_relaxed);
+		return CurrentState == EAcceptState::Accepting || (CurrentState == EAcceptState::Unknown && IsInGameThread() && TryAcceptOnGameThread());
+	}
+	/**
+	 * Queries the analytics module for the active provider and caches the answer along with the send policy's. Game thread
+	 * only, and never while the analytics module is still creating the provider
+	 */
+	void ResolveAcceptState();
+	/**
+	 * Resolves an unknown state for a call from the game thread, only keeping the answer when it's accepting. The analytics
+	 * module may not have picked its provider yet, rejections are settled by the flush tick
+	 */
+	bool TryAcceptOnGameThread() const;
+	/**
+	 * Whether the analytics module has this instance as its active provider and the send policy lets the events out. Game thread only
+	 */
+	bool QueryAcceptState() const;
 
 	/**
-	 * Data structure to hold all the information about an individual event
+	 * Rough size of a serialized event, used to reserve the batch body upfront
 	 */
-	struct FCachedEvent
-	{
-		FString Name;
-		FDateTime Timestamp;
-		FString World;
-		TOptional<FTransform> Transform;
-		TArray<FAnalyticsEventAttribute> Attributes;
-	};
+	static constexpr int32 EstimatedBytesPerEvent = 768;
+	/**
+	 * Value of the "version" field of batches using ECtcAnalyticsWireFormat::SharedContext
+	 */
+	static constexpr int32 SharedContextWireVersion = 2;
+	/**
+	 * Upper bound of the bytes closing a backend request after its last event
+	 */
+	static constexpr int32 MaxChunkTrailerSize = 64;
+	/**
+	 * Memory of the cached events. Recording allocates from the active arena, each snapshot retires it and activates one no
+	 * event references anymore, so in steady state two arenas take turns and their blocks are reused
+	 */
+	TArray<TUniquePtr<FCtcAnalyticsEventArena>> EventArenas;
+	std::atomic<FCtcAnalyticsEventArena*> ActiveEventArena = nullptr;
+	/**
+	 * Events already recorded we will send next flush. Any thread can enqueue, only the flush dequeues
+	 */
+	TCtcAnalyticsEventQueue<FCachedEvent> PendingEvents;
+	/**
+	 * Number of events currently waiting for the next flush, either inside PendingEvents or spilled to disk
+	 */
+	std::atomic<int32> NumPendingEvents = 0;
+	/**
+	 * Events listed in the CriticalEvents setting, waiting to be sent by SendCriticalEvents
+	 */
+	TCtcAnalyticsEventQueue<FCachedEvent> CriticalEvents;
+	std::atomic<bool> bCriticalFlushRequested = false;
+	/**
+	 * Memory taken by the events inside PendingEvents
+	 */
+	std::atomic<int64> PendingEventsMemory = 0;
+	/**
+	 * Guards the consumer side of PendingEvents. Taken by the flush, and by producers evicting old events
+	 */
+	FCriticalSection DequeueLock;
 	/**
-	 * Events already recorded we will send next flush
+	 * Events which didn't fit in memory when using ECtcAnalyticsOverflowPolicy::SpillToDisk
 	 */
-	TArray<FCachedEvent> CachedEvents;
+	FCtcAnalyticsSpillFile SpillFile;
+	std::atomic<int32> NumSpilledEvents = 0;
+	/**
+	 * Number of events of each name seen while downsampling
+	 */
+	FCriticalSection DownsampleLock;
+	TMap<int32, uint32> DownsampleCounters;
+	/**
+	 * Copy of the cache limits from the settings
+	 */
+	std::atomic<int64> MaxCachedEventsMemory = MAX_int64;
+	std::atomic<ECtcAnalyticsOverflowPolicy> OverflowPolicy = ECtcAnalyticsOverflowPolicy::DropOldest;
+	std::atomic<int32> DownsampleRate = 1;
+	std::atomic<int32> FlushEventThreshold = MAX_int32;
+	std::atomic<int64> FlushMemoryThreshold = MAX_int64;
+	/**
+	 * Set once the cache crossed a flush threshold, until the flush happens
+	 */
+	std::atomic<bool> bEarlyFlushRequested = false;
+	/**
+	 * Timers of the next flushes. Guarded by FlushTimerLock since flushes can be requested from any thread
+	 */
+	FCriticalSection FlushTimerLock;
+	FTSTicker::FDelegateHandle FlushTimerHandle;
+	FTSTicker::FDelegateHandle CriticalFlushTimerHandle;
+	double NextFlushTime = 0.0;
+	/**
+	 * Current interval between flushes, grows while there are barely any events to send
+	 */
+	double CurrentSendInterval = 0.0;
+	/**
+	 * FPlatformTime::Seconds when the pending flush was first pushed back because of slow frames, 0 if it wasn't
+	 */
+	double FlushDeferredSince = 0.0;
+	FTSTicker::FDelegateHandle DebugDisplayTickerHandle;
+	/**
+	 * Delay between checks of the frame time while a flush is pushed back
+	 */
+	static constexpr double FlushDeferralStep = 0.5;
+	/**
+	 * Refresh interval of the on screen debug display
+	 */
+	static constexpr float DebugDisplayInterval = 0.25f;
+	/**
+	 * Names of the events, attribute keys and worlds. They repeat across many events, which only keep their IDs. The active
+	 * provider uses the process-wide event names and keys, whose IDs stay valid for the whole process so typed events
+	 * resolve them once. Detached providers own their tables and leave the shared ones untouched
+	 */
+	static FCtcAnalyticsNameTable SharedEventNames;
+	static FCtcAnalyticsNameTable SharedAttributeKeys;
+	TUniquePtr<FCtcAnalyticsNameTable> OwnedEventNames;
+	TUniquePtr<FCtcAnalyticsNameTable> OwnedAttributeKeys;
+	FCtcAnalyticsNameTable& EventNames;
+	FCtcAnalyticsNameTable& AttributeKeys;
+	FCtcAnalyticsNameTable WorldNames;
+	/**
+	 * World which last began play, and its ID in WorldNames given to the new events from any thread. Updated on the game thread
+	 */
+	const UWorld* CurrentWorld = nullptr;
+	std::atomic<int32> CurrentWorldId = FCtcAnalyticsNameTable::EmptyId;
+	/**
+	 * Context used by the next batches. Reset whenever any of the session information or attributes change
+	 */
+	TSharedPtr<const FBatchContext> BatchContext;
+	/**
+	 * Serializes the snapshot and serialization stages of all flushes
+	 */
+	UE::Tasks::FPipe FlushPipe{TEXT("CtcAnalyticsFlushPipe")};
+	/**
+	 * Destination of the batches when running with -AnalyticsToFile
+	 */
+	FCtcAnalyticsFileSink FileSink;
+	/**
+	 * Durable copy of every batch sent to the backend until it's acknowledged
+	 */
+	FCtcAnalyticsOutbox Outbox;
+	/**
+	 * Sends the batches to the backend, retrying them when needed
+	 */
+	FCtcAnalyticsSendScheduler SendScheduler{Outbox};
+	/**
+	 * Whether crash handlers persist the pending events into the outbox's crash segment
+	 */
+	bool bCrashDumpEnabled = false;
+	/**
+	 * Size of the crash buffer up to the last event written by a crash dump, 0 until one is. Later dumps append from there
+	 */
+	int32 CrashDumpEventsEnd = 0;
+	double LastShutdownFlushDuration = 0.0;
+	/**
+	 * Events dropped since the last flush, reported in the next batch. Because of the send backlog, because the cache was
+	 * over its memory budget, and because of downsampling
+	 */
+	std::atomic<int32> NumDroppedEvents = 0;
+	std::atomic<int32> NumOverflowDroppedEvents = 0;
+	std::atomic<int32> NumDownsampledEvents = 0;
+	/**
+	 * Sampling and rate limits applied before events are recorded
+	 */
+	FCtcAnalyticsEventFilter EventFilter;
+	/**
+	 * Events rejected by the rate limits since the last flush. Sampled out events are expected and not counted
+	 */
+	std::atomic<int32> NumRateLimitedEvents = 0;
+	/**
+	 * Crash and termination events lost because the crash segment wasn't available, reported if the process survives them
+	 */
+	std::atomic<int32> NumLostCrashEvents = 0;
+	/**
+	 * Sequence number of the next backend request of the current session
+	 */
+	std::atomic<int32> NextBatchSequence = 0;
+	/**
+	 * Flushes and uploads launched from the game thread which haven't been dispatched yet
+	 */
+	TArray<UE::Tasks::FTask> InFlightFlushes;
+	/**
+	 * Dispatch stage of the latest flush, the next one waits for it so batches leave in the order they were drained
+	 */
+	UE::Tasks::FTask LastDispatchTask;
 	/**
 	 * Information automatically appended by the plugin every event's extra properties
 	 */
@@ -131,9 +832,32 @@ private:
 	 */
 	TOptional<FString> UserID;
 	/*
-	 * Last UTC timestamp of the last sent of the cached events
+	 * FPlatformTime::Seconds of the last sent of the cached events
+	 */
+	double LastFlushTime = 0.0;
+
+	/**
+	 * Whether this instance records the events it's given, resolved on the game thread. Unknown rejects the events of other threads
+	 */
+	enum class EAcceptState : uint8
+	{
+		Unknown,
+		Accepting,
+		Rejecting
+	};
+	mutable std::atomic<EAcceptState> AcceptState = EAcceptState::Unknown;
+	/**
+	 * Provider returned by GetActive
+	 */
+	static std::atomic<FCtcAnalyticsProvider*> Instance;
+	/**
+	 * Resolved by RefreshSendPolicy on the game thread, batches get a copy through their context
+	 */
+	FSendPolicy SendPolicy;
+	/**
+	 * Whether SendPolicy lets events out, read when resolving AcceptState
 	 */
-	FDateTime LastTickSend;
+	bool bIsSendingAllowed = true;
 
 	/**
 	 * Current state of the session
@@ -144,5 +868,5 @@ private:
 		Started,
 		Ended
 	};
-	ESessionState State = ESessionState::None;
+	std::atomic<ESessionState> State = ESessionState::None;
 };
@@ -0,0 +1,21 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <Commandlets/Commandlet.h>
+
+#include "CtcAnalyticsRecordingBenchmarkCommandlet.generated.h"
+
+/**
+ * Counts the heap allocations and the time of each way to record an event, in steady state. Run with
+ * -run=CtcAnalyticsRecordingBenchmark. Counting wraps GMalloc for the rest of the process, which is why it runs on its own
+ * instead of next to the automation tests
+ */
+UCLASS()
+class UCtcAnalyticsRecordingBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,167 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <Containers/Ticker.h>
+#include <Interfaces/IHttpRequest.h>
+#include <Tasks/Task.h>
+
+#include <atomic>
+
+#include "CtcSharedSettings.h"
+
+class FCtcAnalyticsOutbox;
+
+/**
+ * A single request body waiting to be sent to the backend
+ */
+struct FCtcAnalyticsOutboundRequest
+{
+	FString Url;
+	FString ApiKey;
+	/**
+	 * Request body. Left empty for requests recovered from the outbox, loaded from SegmentPath when the request starts
+	 */
+	TArray<uint8> Body;
+	ECtcAnalyticsCompression ContentEncoding = ECtcAnalyticsCompression::None;
+	/**
+	 * Outbox segment holding the same body, removed once the request doesn't need to be sent anymore
+	 */
+	FString SegmentPath;
+	/**
+	 * Session the request belongs to and its position among the session's requests. Unset for recovered requests
+	 */
+	FString SessionID;
+	int32 Sequence = INDEX_NONE;
+	int32 Attempt = 0;
+	/**
+	 * Critical requests jump ahead of the bulk ones and aren't held back by MaxInFlightRequests
+	 */
+	bool bCritical = false;
+};
+
+/**
+ * Sends the analytics requests to the backend. Caps the number of concurrent requests, retries the failed ones with
+ * exponential backoff and jitter, and pauses a lane while the backend asks us to back off. Bulk requests failing never
+ * hold back the critical ones.
+ */
+class CASTTOCLOUDANALYTICS_API FCtcAnalyticsSendScheduler
+{
+public:
+	explicit FCtcAnalyticsSendScheduler(FCtcAnalyticsOutbox& InOutbox);
+	~FCtcAnalyticsSendScheduler();
+
+	/**
+	 * Queues a request to be sent as soon as the limits allow it. Safe to call from any thread
+	 */
+	void Enqueue(FCtcAnalyticsOutboundRequest&& Request);
+	/**
+	 * Sends a request right away and waits for its completion, bypassing the queue and the retries. Game thread only
+	 * @param Deadline FPlatformTime::Seconds after which the request is abandoned, its outbox segment is kept for the next launch
+	 */
+	void SendAndWait(FCtcAnalyticsOutboundRequest&& Request, double Deadline);
+	/**
+	 * Waits for the requests in flight to complete, up to Deadline. Game thread only
+	 */
+	void WaitForInFlightRequests(double Deadline);
+	/**
+	 * Whether the amount of data waiting to be sent exceeds the configured backlog. Cheap enough for the recording hot path
+	 */
+	bool IsBackpressured() const;
+	/**
+	 * Amount of request data currently queued or in flight
+	 */
+	int64 GetBacklogBytes() const { return BacklogBytes.load(std::memory_order_relaxed); }
+	/**
+	 * Highest sequence of the session up to which every request has been settled, INDEX_NONE if none has been yet.
+	 * Requests are sent in parallel so they can settle in any order, this is the point the backend has seen everything up to
+	 */
+	int32 GetAcknowledgedSequence(const FString& SessionID) const;
+
+private:
+	/**
+	 * Starts as many queued requests as the limits allow. Safe to call from any thread
+	 */
+	void Pump();
+	/**
+	 * Reads the body of a recovered request from its outbox segment on a worker thread, then starts it
+	 */
+	void LoadAndStartRequest(const TSharedRef<FCtcAnalyticsOutboundRequest>& Request);
+	/**
+	 * Sends a request taken out of the queue by Pump
+	 */
+	void StartRequest(const TSharedRef<FCtcAnalyticsOutboundRequest>& Request);
+	/**
+	 * Gives back the slot of a request which isn't in flight anymore and starts the next ones
+	 */
+	void ReleaseInFlightSlot();
+	/**
+	 * Inserts a request behind the queued requests of its lane, or ahead of them when retrying. Called with the lock held
+	 */
+	void InsertInQueue(const TSharedRef<FCtcAnalyticsOutboundRequest>& Request, bool bRetry);
+	/**
+	 * Creates the HTTP request for an outbound request whose body is loaded
+	 */
+	static FHttpRequestRef CreateHttpRequest(const FCtcAnalyticsOutboundRequest& Request);
+	/**
+	 * Callback executed when one of the requests started by Pump completes
+	 */
+	void OnRequestComplete(FHttpRequestPtr HttpRequest, FHttpResponsePtr Response, bool bSuccess, TSharedRef<FCtcAnalyticsOutboundRequest> Request);
+	/**
+	 * Releases the request data and, unless it has to be sent again by a later run, its outbox segment
+	 */
+	void Complete(const FCtcAnalyticsOutboundRequest& Request, bool bRemoveSegment);
+	/**
+	 * Records that a request of a session won't be sent again by this run and advances the session's acknowledged sequence
+	 */
+	void Acknowledge(const FCtcAnalyticsOutboundRequest& Request);
+	/**
+	 * Computes how long to wait before retrying, honoring the backend's Retry-After header when present
+	 */
+	static double GetRetryDelay(const FCtcAnalyticsOutboundRequest& Request, const FHttpResponsePtr& Response);
+	/**
+	 * Time left until the first paused lane resumes, 0 if no lane is paused
+	 */
+	double GetRemainingPause() const;
+	/**
+	 * Makes sure Pump runs again once the current pauses are over
+	 */
+	void ScheduleResume(double Delay);
+
+	/**
+	 * Settled requests of a session. Sequences settled ahead of a pending one wait in OutOfOrder until the gap closes
+	 */
+	struct FSessionAcks
+	{
+		int32 NextExpected = 0;
+		TSet<int32> OutOfOrder;
+	};
+
+	FCtcAnalyticsOutbox& Outbox;
+
+	mutable FCriticalSection Lock;
+	TArray<TSharedRef<FCtcAnalyticsOutboundRequest>> Queue;
+	int32 NumInFlight = 0;
+	/**
+	 * HTTP requests started and not completed yet, cancelled if the scheduler goes away before them
+	 */
+	TArray<FHttpRequestPtr> InFlightRequests;
+	/**
+	 * Recovered requests whose body is being read from the outbox
+	 */
+	TArray<UE::Tasks::FTask> LoadTasks;
+	/**
+	 * Set by the destructor, nothing is started anymore
+	 */
+	bool bShuttingDown = false;
+	/**
+	 * FPlatformTime::Seconds before which no request of the lane is started
+	 */
+	double CriticalPausedUntil = 0.0;
+	double BulkPausedUntil = 0.0;
+	FTSTicker::FDelegateHandle ResumeTickerHandle;
+	TMap<FString, FSessionAcks> SessionAcks;
+
+	std::atomic<int64> BacklogBytes = 0;
+	std::atomic<int64> MaxBacklogBytes = MAX_int64;
+};
@@ -0,0 +1,105 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+class IFileHandle;
+
+/**
+ * Scratch file holding the records which didn't fit in the in-memory event cache until the next flush reads them
+ * back. Records are buffered and written in blocks, the file only lives for the current run.
+ */
+class CASTTOCLOUDANALYTICS_API FCtcAnalyticsSpillFile
+{
+public:
+	/**
+	 * Reads back the records spilled up to a TakeContents call, a few at a time. Deletes their file once destroyed
+	 */
+	class CASTTOCLOUDANALYTICS_API FReader
+	{
+	public:
+		FReader() = default;
+		FReader(FReader&& Other);
+		~FReader();
+
+		/**
+		 * Reads the next records, as many as fit in about MaxReadSize bytes. The records are concatenated in OutRecords
+		 * @return False once every record was read
+		 */
+		bool ReadRecords(TArray<uint8>& OutRecords);
+
+	private:
+		friend class FCtcAnalyticsSpillFile;
+
+		bool ReadBytes(void* Data, int64 Size);
+
+		FString Path;
+		TUniquePtr<IFileHandle> FileHandle;
+		/**
+		 * Records which never left the buffer, read from memory instead of the file
+		 */
+		TArray<uint8> Buffer;
+		int64 Offset = 0;
+		int64 Size = 0;
+	};
+
+	explicit FCtcAnalyticsSpillFile(const FString& InDirectory);
+	~FCtcAnalyticsSpillFile();
+
+	/**
+	 * Appends a record to the file. Safe to call from any thread
+	 * @return False if the record couldn't be written or the file is full
+	 */
+	bool Append(TConstArrayView<uint8> Record);
+	/**
+	 * Hands everything appended so far over to a reader and starts a new file
+	 */
+	FReader TakeContents();
+	/**
+	 * Whether anything was appended since the last call to TakeContents
+	 */
+	bool IsEmpty() const;
+	/**
+	 * Amount of data appended since the last call to TakeContents, buffered or written
+	 */
+	int64 GetSize() const { return SpilledBytes.load(std::memory_order_relaxed); }
+	/**
+	 * Number of appended records which were lost because the file couldn't be written, since the last call
+	 */
+	int32 TakeNumLostRecords() { return NumLostRecords.exchange(0, std::memory_order_relaxed); }
+	/**
+	 * Caps the amount of data the file can hold, records appended past it are rejected
+	 */
+	void SetMaxSize(int64 InMaxSize) { MaxSize.store(InMaxSize, std::memory_order_relaxed); }
+
+	/**
+	 * Amount of data read at once by FReader::ReadRecords
+	 */
+	static constexpr int64 MaxReadSize = 1024 * 1024;
+
+private:
+	/**
+	 * Writes the buffered records into the file, opening it when needed. Called with the lock held
+	 */
+	bool FlushBuffer();
+
+	/**
+	 * Amount of buffered data after which the records are written to the file
+	 */
+	static constexpr int32 MaxBufferSize = 64 * 1024;
+
+	FString Directory;
+	FString Path;
+
+	mutable FCriticalSection Lock;
+	TUniquePtr<IFileHandle> FileHandle;
+	TArray<uint8> Buffer;
+	int32 NumBufferedRecords = 0;
+	int64 FileSize = 0;
+	bool bStaleFilesDeleted = false;
+
+	std::atomic<int64> SpilledBytes = 0;
+	std::atomic<int64> MaxSize = MAX_int64;
+	std::atomic<int32> NumLostRecords = 0;
+};
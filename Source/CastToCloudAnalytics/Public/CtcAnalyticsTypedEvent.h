@@ -0,0 +1,35 @@
+// Copyright Cast To Cloud 2024-2026. All Rights Reserved.
+
+#pragma once
+
+#include <CoreMinimal.h>
+
+#include <tuple>
+
+/**
+ * Field of an event recorded with FCtcAnalyticsProvider::RecordTyped: the key it's sent under and the member holding its value
+ */
+template <typename EventType, typename ValueType>
+struct TCtcAnalyticsEventField
+{
+	const TCHAR* Key;
+	ValueType EventType::*Member;
+};
+
+/**
+ * Declares a field of a typed event, deducing its types from the member pointer
+ */
+template <typename EventType, typename ValueType>
+constexpr TCtcAnalyticsEventField<EventType, ValueType> CtcAnalyticsField(const TCHAR* Key, ValueType EventType::*Member)
+{
+	return {Key, Member};
+}
+
+/**
+ * Declares all the fields of a typed event, in the order they are sent
+ */
+template <typename... FieldTypes>
+constexpr std::tuple<FieldTypes...> CtcAnalyticsFields(FieldTypes... Fields)
+{
+	return std::tuple<FieldTypes...>(Fields...);
+}